@@ -0,0 +1,45 @@
+QT       += core gui svg concurrent
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# The following define makes your compiler emit warnings if you use
+# any Qt feature that has been marked deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# 描画まわりは GraphWidget のソースをそのまま使う (ウィジェットには依存しない)
+INCLUDEPATH += ../GraphWidget
+
+# qmake CONFIG+=alloc_count で確保回数を数える (--alloc-check で使う)
+alloc_count: DEFINES += GRAPH_ALLOC_COUNT
+
+SOURCES += \
+    ../GraphWidget/alloccounter.cpp \
+    ../GraphWidget/autoscale.cpp \
+    ../GraphWidget/axis.cpp \
+    ../GraphWidget/chunkstore.cpp \
+    ../GraphWidget/renderer.cpp \
+    ../GraphWidget/rollup.cpp \
+    ../GraphWidget/series.cpp \
+    chartjob.cpp \
+    columnmodel.cpp \
+    main.cpp
+
+HEADERS += \
+    ../GraphWidget/alloccounter.h \
+    ../GraphWidget/autoscale.h \
+    ../GraphWidget/axis.h \
+    ../GraphWidget/chunkstore.h \
+    ../GraphWidget/columnprovider.h \
+    ../GraphWidget/renderer.h \
+    ../GraphWidget/rollup.h \
+    ../GraphWidget/series.h \
+    chartjob.h \
+    columnmodel.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,169 @@
+#include "chartjob.h"
+
+#include <QFile>
+#include <QImage>
+#include <QObject>
+#include <QPainter>
+#include <QSvgGenerator>
+#include <QTextStream>
+#include <cmath>
+#include <limits>
+
+#include "alloccounter.h"
+#include "axis.h"
+#include "columnmodel.h"
+#include "renderer.h"
+#include "series.h"
+
+using namespace std;
+
+bool loadCsv(const QString &fileName, QVector<QVector<double> > &columns)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    columns.clear();
+    QTextStream in(&file);
+    QString line;
+    while (in.readLineInto(&line)) {
+        QStringList fields = line.split(QLatin1Char(','));
+        if (columns.isEmpty())
+            columns.resize(fields.size());
+        if (fields.size() < columns.size())
+            continue;
+
+        QVector<double> values(columns.size());
+        bool ok = true;
+        for (int column = 0; column < columns.size() && ok; ++column)
+            values[column] = fields.at(column).trimmed().toDouble(&ok);
+        if (!ok) // ヘッダ行など
+            continue;
+
+        for (int column = 0; column < columns.size(); ++column)
+            columns[column].append(values.at(column));
+    }
+
+    return columns.size() >= 2 && !columns.first().isEmpty();
+}
+
+void makeSynthetic(int seed, int samples, int series, QVector<QVector<double> > &columns)
+{
+    columns.clear();
+    columns.resize(series + 1);
+    for (int column = 0; column <= series; ++column)
+        columns[column].resize(samples);
+
+    // 乱数は使わず seed ごとに周期と位相を変えた波形
+    for (int n = 0; n < samples; ++n) {
+        double x = double(n) / 100;
+        columns[0][n] = x;
+        for (int s = 1; s <= series; ++s)
+            columns[s][n] = s * sin(x * (1 + 0.1 * s) + seed) + 0.2 * sin(x * 13.0 * s);
+    }
+}
+
+// 1 列目以降を系列として登録し、軸をデータ全体に合わせる
+static void addSeries(SeriesRegistry &series, Axes &axes, int columnCount)
+{
+    static const Qt::GlobalColor colors[] = {
+        Qt::red, Qt::green, Qt::cyan, Qt::yellow, Qt::magenta, Qt::white
+    };
+    const int colorCount = int(sizeof(colors) / sizeof(colors[0]));
+
+    double xMin = numeric_limits<double>::max();
+    double xMax = -numeric_limits<double>::max();
+    double yMin = numeric_limits<double>::max();
+    double yMax = -numeric_limits<double>::max();
+    series.reserve(columnCount - 1);
+    for (int section = 1; section < columnCount; ++section) {
+        int id = series.add(section);
+        series.setAxisIndex(id, 0);
+
+        Plot plot = series.at(id);
+        plot.setLineColor(colors[(section - 1) % colorCount]);
+        plot.recalculateMinMaxAllData(true);
+        xMin = qMin(xMin, plot.minData().x());
+        xMax = qMax(xMax, plot.maxData().x());
+        yMin = qMin(yMin, plot.minData().y());
+        yMax = qMax(yMax, plot.maxData().y());
+    }
+    axes.xAxis()->adjust(xMin, xMax, Axis::Forced);
+    axes.yAxes(0)->adjust(yMin, yMax, Axis::Forced);
+}
+
+bool renderChart(const ChartJob &job, const RenderOptions &options)
+{
+    QVector<QVector<double> > columns;
+    if (job.source.isEmpty())
+        makeSynthetic(job.seed, options.samples, options.series, columns);
+    else if (!loadCsv(job.source, columns))
+        return false;
+
+    ColumnModel model;
+    model.setColumns(columns);
+
+    SeriesRegistry series;
+    series.setModel(&model);
+
+    QObject owner; // 軸の親
+    Axes axes(1, &owner);
+    addSeries(series, axes, columns.size());
+
+    Renderer renderer(&series, &axes);
+    if (options.svg) {
+        QSvgGenerator generator;
+        generator.setFileName(job.output);
+        generator.setSize(options.size);
+        generator.setViewBox(QRect(QPoint(0, 0), options.size));
+
+        QPainter painter;
+        if (!painter.begin(&generator))
+            return false;
+        renderer.render(&painter, options.size);
+        return painter.end();
+    }
+
+    return renderer.renderImage(options.size).save(job.output, "PNG");
+}
+
+QVector<quint64> measureIncrementalAllocations(const RenderOptions &options, int frames)
+{
+    QVector<QVector<double> > columns;
+    makeSynthetic(0, options.samples, options.series, columns);
+
+    ColumnModel model;
+    model.setColumns(columns);
+
+    SeriesRegistry series;
+    series.setModel(&model);
+
+    QObject owner;
+    Axes axes(1, &owner);
+    addSeries(series, axes, columns.size());
+
+    // 前半を全体再描画し、残りを frames 回に分けて追記する
+    // (データが尽きたら打ち切り、空のフレームは数えない)
+    int rows = options.samples / 2;
+    int step = qMax(1, (options.samples - rows) / qMax(1, frames));
+    model.setRowCount(rows);
+
+    QImage image(options.size, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&image);
+    Renderer renderer(&series, &axes);
+    renderer.render(&painter, options.size);
+    renderer.clipCurves(&painter);
+
+    // Graph::onDataUpdate と同じく 1 つの QPainter で追記を描き続ける
+    QVector<quint64> allocations;
+    allocations.reserve(frames);
+    while (allocations.size() < frames && rows < options.samples) {
+        rows = qMin(options.samples, rows + step);
+        model.setRowCount(rows);
+
+        quint64 before = AllocCounter::count();
+        renderer.drawCurves(&painter, false);
+        allocations.append(AllocCounter::count() - before);
+    }
+    return allocations;
+}
@@ -0,0 +1,34 @@
+#ifndef CHARTJOB_H
+#define CHARTJOB_H
+
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+struct RenderOptions {
+    QSize size;
+    bool svg;
+    int samples;    // 合成データの 1 系列あたりのサンプル数
+    int series;     // 合成データの系列数
+};
+
+// 1 枚分の出力 (source が空なら seed から合成データを作る)
+struct ChartJob {
+    QString source;
+    QString output;
+    int seed;
+    bool ok;
+};
+
+// 0 列目を X、以降を系列とする CSV (数値にならない行は読み飛ばす)
+bool loadCsv(const QString &fileName, QVector<QVector<double> > &columns);
+void makeSynthetic(int seed, int samples, int series, QVector<QVector<double> > &columns);
+
+// ウィジェットを作らずに PNG / SVG へ描画する (スレッドごとに独立して呼べる)
+bool renderChart(const ChartJob &job, const RenderOptions &options);
+
+// 合成データの後半を最大 frames 回に分けて追記して描き、各フレームの drawCurves 中の確保回数を返す
+// (CONFIG+=alloc_count でビルドした時のみ数える。それ以外は全て 0)
+QVector<quint64> measureIncrementalAllocations(const RenderOptions &options, int frames);
+
+#endif // CHARTJOB_H
@@ -0,0 +1,63 @@
+#include "columnmodel.h"
+
+ColumnModel::ColumnModel(QObject *parent)
+    : QAbstractTableModel(parent),
+      m_rowCount(0),
+      m_columnRows(0)
+{
+}
+
+void ColumnModel::setColumns(const QVector<QVector<double> > &columns)
+{
+    beginResetModel();
+    m_columns = columns;
+    m_rowCount = 0;
+    if (!m_columns.isEmpty()) {
+        m_rowCount = m_columns.first().size();
+        foreach (const QVector<double> &column, m_columns)
+            m_rowCount = qMin(m_rowCount, column.size());
+    }
+    m_columnRows = m_rowCount;
+    endResetModel();
+}
+
+void ColumnModel::setRowCount(int rows)
+{
+    rows = qBound(0, rows, m_columnRows);
+    if (rows > m_rowCount) {
+        beginInsertRows(QModelIndex(), m_rowCount, rows - 1);
+        m_rowCount = rows;
+        endInsertRows();
+    }
+    else if (rows < m_rowCount) {
+        beginRemoveRows(QModelIndex(), rows, m_rowCount - 1);
+        m_rowCount = rows;
+        endRemoveRows();
+    }
+}
+
+int ColumnModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rowCount;
+}
+
+int ColumnModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_columns.size();
+}
+
+QVariant ColumnModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+        return QVariant();
+    return m_columns.at(index.column()).at(index.row());
+}
+
+int ColumnModel::columnSpan(int column, int first, int count, const double **data) const
+{
+    if (column < 0 || column >= m_columns.size() || first < 0 || first >= m_rowCount)
+        return 0;
+
+    *data = m_columns.at(column).constData() + first;
+    return qMin(count, m_rowCount - first);
+}
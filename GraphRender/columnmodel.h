@@ -0,0 +1,34 @@
+#ifndef COLUMNMODEL_H
+#define COLUMNMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+
+#include "columnprovider.h"
+
+// 列ごとの double 配列をそのまま持つ読み取り専用モデル
+class ColumnModel : public QAbstractTableModel, public ColumnProvider
+{
+    Q_OBJECT
+    Q_INTERFACES(ColumnProvider)
+
+public:
+    explicit ColumnModel(QObject *parent = 0);
+
+    void setColumns(const QVector<QVector<double> > &columns);
+    // 先頭から rows 行だけを見せる (増やした分は行の追加として通知する)
+    void setRowCount(int rows);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    int columnSpan(int column, int first, int count, const double **data) const;
+
+private:
+    QVector<QVector<double> > m_columns;
+    int m_rowCount;
+    int m_columnRows;
+};
+
+#endif // COLUMNMODEL_H
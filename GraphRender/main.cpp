@@ -0,0 +1,128 @@
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "chartjob.h"
+
+int main(int argc, char *argv[])
+{
+    // 表示先のない環境でもフォントを使えるようにする
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication a(argc, argv);
+    QCoreApplication::setApplicationName("GraphRender");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders charts to PNG or SVG in parallel without widgets.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "CSV files (column 0 is X, the others are series).", "[files...]");
+
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Output directory.", "dir", ".");
+    QCommandLineOption formatOption(QStringList() << "f" << "format", "Output format (png or svg).", "format", "png");
+    QCommandLineOption sizeOption(QStringList() << "s" << "size", "Image size.", "WxH", "800x600");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Number of worker threads.", "n");
+    QCommandLineOption syntheticOption("synthetic", "Render n generated charts.", "n", "0");
+    QCommandLineOption samplesOption("samples", "Samples per generated series.", "n", "10000");
+    QCommandLineOption seriesOption("series", "Series per generated chart.", "n", "4");
+    QCommandLineOption allocCheckOption("alloc-check",
+                                        "Append to a generated chart for n frames and report heap allocations "
+                                        "per incremental frame (requires CONFIG+=alloc_count).", "n");
+    parser.addOption(outputOption);
+    parser.addOption(formatOption);
+    parser.addOption(sizeOption);
+    parser.addOption(jobsOption);
+    parser.addOption(syntheticOption);
+    parser.addOption(samplesOption);
+    parser.addOption(seriesOption);
+    parser.addOption(allocCheckOption);
+    parser.process(a);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    RenderOptions options;
+    QStringList size = parser.value(sizeOption).split(QLatin1Char('x'));
+    options.size = (size.size() == 2) ? QSize(size.at(0).toInt(), size.at(1).toInt()) : QSize();
+    options.svg = (parser.value(formatOption).toLower() == "svg");
+    options.samples = qMax(2, parser.value(samplesOption).toInt());
+    options.series = qMax(1, parser.value(seriesOption).toInt());
+    if (!options.size.isValid() || options.size.isEmpty()) {
+        err << "invalid size: " << parser.value(sizeOption) << "\n";
+        return 1;
+    }
+
+    if (parser.isSet(allocCheckOption)) {
+#ifdef GRAPH_ALLOC_COUNT
+        // 最初の数フレームは作業用配列が追記分の大きさまで育つため除く
+        const int warmupFrames = 2;
+        QVector<quint64> allocations
+                = measureIncrementalAllocations(options, qMax(warmupFrames + 1, parser.value(allocCheckOption).toInt()));
+        if (allocations.size() <= warmupFrames) {
+            err << "not enough samples to append; increase --samples" << "\n";
+            return 1;
+        }
+        quint64 steady = 0;
+        for (int frame = 0; frame < allocations.size(); ++frame) {
+            out << "frame " << frame << ": " << allocations.at(frame) << " allocations" << "\n";
+            if (frame >= warmupFrames)
+                steady += allocations.at(frame);
+        }
+        out << steady << " allocations after " << warmupFrames << " warm-up frames" << "\n";
+        return steady ? 1 : 0;
+#else
+        err << "allocation counting is disabled; rebuild with CONFIG+=alloc_count" << "\n";
+        return 1;
+#endif
+    }
+
+    QDir dir(parser.value(outputOption));
+    if (!dir.mkpath(".")) {
+        err << "cannot create " << dir.path() << "\n";
+        return 1;
+    }
+    QString suffix = options.svg ? "svg" : "png";
+
+    QVector<ChartJob> jobs;
+    foreach (const QString &file, parser.positionalArguments()) {
+        ChartJob job = { file, dir.filePath(QFileInfo(file).completeBaseName() + "." + suffix), 0, false };
+        jobs.append(job);
+    }
+    int synthetic = parser.value(syntheticOption).toInt();
+    for (int n = 0; n < synthetic; ++n) {
+        ChartJob job = { QString(), dir.filePath(QString("chart%1.%2").arg(n, 5, 10, QChar('0')).arg(suffix)), n, false };
+        jobs.append(job);
+    }
+    if (jobs.isEmpty())
+        parser.showHelp(1);
+
+    if (parser.isSet(jobsOption))
+        QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+
+    QElapsedTimer timer;
+    timer.start();
+    QtConcurrent::blockingMap(jobs, [&options](ChartJob &job) {
+        job.ok = renderChart(job, options);
+    });
+    double seconds = timer.nsecsElapsed() / 1e9;
+
+    int failed = 0;
+    foreach (const ChartJob &job, jobs) {
+        if (!job.ok) {
+            err << "failed: " << (job.source.isEmpty() ? job.output : job.source) << "\n";
+            failed++;
+        }
+    }
+
+    int rendered = jobs.size() - failed;
+    out << rendered << " charts in " << QString::number(seconds, 'f', 3) << " s ("
+        << QString::number(seconds > 0.0 ? rendered / seconds : 0.0, 'f', 1) << " charts/s, "
+        << QThreadPool::globalInstance()->maxThreadCount() << " threads)" << "\n";
+
+    return failed ? 1 : 0;
+}
@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -15,13 +15,40 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Counts heap allocations with a global operator new and reports any made
+# while drawing incremental frames (debug builds only).
+#DEFINES += GRAPH_ALLOC_COUNT
+
 SOURCES += \
+    alloccounter.cpp \
+    autoscale.cpp \
+    axis.cpp \
+    chunkstore.cpp \
     graph.cpp \
+    ingestserver.cpp \
     main.cpp \
+    renderer.cpp \
+    rollup.cpp \
+    series.cpp \
+    spectrum.cpp \
+    trigger.cpp \
     widget.cpp
 
 HEADERS += \
+    alloccounter.h \
+    autoscale.h \
+    axis.h \
+    chunkstore.h \
+    columnprovider.h \
     graph.h \
+    ingestframe.h \
+    ingestserver.h \
+    renderer.h \
+    rollup.h \
+    series.h \
+    snapshot.h \
+    spectrum.h \
+    trigger.h \
     widget.h
 
 FORMS += \
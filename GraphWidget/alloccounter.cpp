@@ -0,0 +1,67 @@
+#include "alloccounter.h"
+
+#ifdef GRAPH_ALLOC_COUNT
+
+#include <cstdlib>
+#include <new>
+
+static thread_local quint64 allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    allocations++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t &) Q_DECL_NOTHROW
+{
+    allocations++;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t &tag) Q_DECL_NOTHROW
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *p) Q_DECL_NOTHROW
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) Q_DECL_NOTHROW
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) Q_DECL_NOTHROW
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) Q_DECL_NOTHROW
+{
+    std::free(p);
+}
+
+quint64 AllocCounter::count()
+{
+    return allocations;
+}
+
+#else
+
+quint64 AllocCounter::count()
+{
+    return 0;
+}
+
+#endif
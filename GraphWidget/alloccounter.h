@@ -0,0 +1,16 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <QtGlobal>
+
+// DEFINES += GRAPH_ALLOC_COUNT の時はグローバルな operator new を置き換えて
+// 確保の回数を数える (それ以外では常に 0)
+// 他のスレッド (Ingest やスレッドプール) の確保が混ざらないようにスレッドごとに数える
+namespace AllocCounter {
+
+// 呼び出したスレッドでのこれまでの確保回数
+quint64 count();
+
+}
+
+#endif // ALLOCCOUNTER_H
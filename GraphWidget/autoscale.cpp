@@ -0,0 +1,123 @@
+#include "autoscale.h"
+
+#include <cmath>
+
+using namespace std;
+
+AutoScalePolicy::AutoScalePolicy()
+    : m_fitted(false),
+      m_updates(0),
+      m_redraws(0)
+{
+}
+
+bool AutoScalePolicy::fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max)
+{
+    m_fitted = true;
+    min = dataMin;
+    max = dataMax;
+    return true;
+}
+
+void AutoScalePolicy::record(bool redraw)
+{
+    m_updates++;
+    if (redraw)
+        m_redraws++;
+}
+
+
+HeadroomPolicy::HeadroomPolicy(qreal factor)
+    : m_factor(qMax(qreal(1.1), factor))
+{
+}
+
+bool HeadroomPolicy::fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max)
+{
+    if (!m_fitted || !(max > min))
+        return AutoScalePolicy::fit(dataMin, dataMax, min, max);
+
+    if (dataMin >= min && dataMax <= max)
+        return false;
+
+    while (max < dataMax)
+        max = min + (max - min) * m_factor;
+    while (min > dataMin)
+        min = max - (max - min) * m_factor;
+
+    return true;
+}
+
+
+HysteresisPolicy::HysteresisPolicy(qreal factor, qreal shrinkRatio, int holdUpdates)
+    : HeadroomPolicy(factor),
+      m_shrinkRatio(qBound(qreal(0.0), shrinkRatio, qreal(1.0))),
+      m_holdUpdates(qMax(1, holdUpdates)),
+      m_shrinkCount(0)
+{
+}
+
+bool HysteresisPolicy::fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max)
+{
+    if (!m_fitted || dataMin < min || dataMax > max) {
+        m_shrinkCount = 0;
+        return HeadroomPolicy::fit(dataMin, dataMax, min, max);
+    }
+
+    if ((dataMax - dataMin) < (max - min) * m_shrinkRatio) {
+        if (++m_shrinkCount >= m_holdUpdates) {
+            m_shrinkCount = 0;
+            return AutoScalePolicy::fit(dataMin, dataMax, min, max);
+        }
+    }
+    else {
+        m_shrinkCount = 0;
+    }
+
+    return false;
+}
+
+void HysteresisPolicy::reset()
+{
+    HeadroomPolicy::reset();
+    m_shrinkCount = 0;
+}
+
+
+SlidingWindowPolicy::SlidingWindowPolicy(qreal window, qreal step)
+    : m_window(window),
+      m_step(step),
+      m_end(0.0)
+{
+}
+
+bool SlidingWindowPolicy::fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max)
+{
+    if (!(m_window > 0.0))
+        return AutoScalePolicy::fit(dataMin, dataMax, min, max);
+
+    qreal step = (m_step > 0.0) ? m_step : m_window / 4;
+    qreal end = ceil(dataMax / step) * step;
+    if (m_fitted && end == m_end)
+        return false;
+
+    m_fitted = true;
+    m_end = end;
+    min = qMax(dataMin, end - m_window);
+    max = end;
+    return true;
+}
+
+
+bool ExpandOnlyPolicy::fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max)
+{
+    if (!m_fitted)
+        return AutoScalePolicy::fit(dataMin, dataMax, min, max);
+
+    if (dataMin >= min && dataMax <= max)
+        return false;
+
+    min = qMin(min, dataMin);
+    max = qMax(max, dataMax);
+    return true;
+}
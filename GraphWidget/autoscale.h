@@ -0,0 +1,90 @@
+#ifndef AUTOSCALE_H
+#define AUTOSCALE_H
+
+#include <QtGlobal>
+
+// Axis の自動スケールで表示範囲をどう追従させるかを決める
+// 基底クラスはデータ範囲にそのまま合わせる (従来の動作)
+class AutoScalePolicy
+{
+
+public:
+    AutoScalePolicy();
+    virtual ~AutoScalePolicy() {}
+
+    // 現在の表示範囲 min/max をデータ範囲に合わせて書き換える
+    // 範囲を変える必要がなければ false を返す
+    virtual bool fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max);
+    virtual void reset() { m_fitted = false; }
+
+    // 全体再描画の発生率
+    void record(bool redraw);
+    int updates() const { return m_updates; }
+    int redraws() const { return m_redraws; }
+    double redrawRate() const { return m_updates ? double(m_redraws) / m_updates : 0.0; }
+    void resetStatistics() { m_updates = m_redraws = 0; }
+
+protected:
+    bool m_fitted;
+
+private:
+    int m_updates;
+    int m_redraws;
+};
+
+// はみ出した側へ span を factor 倍ずつ広げる (再描画回数は範囲の対数に比例)
+class HeadroomPolicy : public AutoScalePolicy
+{
+
+public:
+    explicit HeadroomPolicy(qreal factor = 2.0);
+
+    bool fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max);
+
+private:
+    qreal m_factor;
+};
+
+// 拡大は HeadroomPolicy と同じ、縮小はデータが shrinkRatio 未満の幅に
+// holdUpdates 回続けて収まった場合だけ行う
+class HysteresisPolicy : public HeadroomPolicy
+{
+
+public:
+    explicit HysteresisPolicy(qreal factor = 2.0, qreal shrinkRatio = 0.25, int holdUpdates = 50);
+
+    bool fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max);
+    void reset();
+
+private:
+    qreal m_shrinkRatio;
+    int m_holdUpdates;
+    int m_shrinkCount;
+};
+
+// 最新の window 幅だけを表示し、step 単位でまとめて送る
+class SlidingWindowPolicy : public AutoScalePolicy
+{
+
+public:
+    explicit SlidingWindowPolicy(qreal window, qreal step = 0.0);
+
+    bool fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max);
+
+private:
+    qreal m_window;
+    qreal m_step;
+    qreal m_end;
+};
+
+// 範囲を広げるだけで縮めない
+class ExpandOnlyPolicy : public AutoScalePolicy
+{
+
+public:
+    ExpandOnlyPolicy() {}
+
+    bool fit(qreal dataMin, qreal dataMax, qreal &min, qreal &max);
+};
+
+#endif // AUTOSCALE_H
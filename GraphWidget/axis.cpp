@@ -0,0 +1,169 @@
+#include "axis.h"
+
+#include <cmath>
+
+#include "autoscale.h"
+
+using namespace std;
+
+Axes::Axes(QObject* parent)
+{
+    m_xAxis = new Axis(parent);
+    m_yAxes.insert(0, new Axis(parent));
+}
+
+Axes::Axes(int numAxes, QObject* parent)
+{
+    m_xAxis = new Axis(parent);
+    for (int n = 0; n < numAxes; n++)
+        m_yAxes.append(new Axis(parent));
+}
+
+Axes::~Axes()
+{
+}
+
+
+Axis::Axis(QObject *parent)
+    : QObject(parent),
+      m_adjustSettings({0.0, 10.0, 5}),
+      m_visble(true),
+      m_autoScale(true),
+      m_caption(QString()),
+      m_lineColor(Qt::white),
+      m_maxTickLabelWidth(0),
+      m_policy(new AutoScalePolicy)
+{
+}
+
+Axis::~Axis()
+{
+    delete m_policy;
+}
+
+void Axis::setAutoScalePolicy(AutoScalePolicy *policy)
+{
+    if (m_policy == policy)
+        return;
+
+    delete m_policy;
+    m_policy = policy ? policy : new AutoScalePolicy;
+    m_policy->reset();
+}
+
+bool Axis::autoScaleAdjust(qreal min, qreal max)
+{
+    if (!(min <= max) || !qIsFinite(min) || !qIsFinite(max)) // データなし
+        return false;
+
+    // ポリシーが範囲を変えない限り adjustAxis (全体再描画) に進まない
+    qreal low = m_adjustSettings.min;
+    qreal high = m_adjustSettings.max;
+    bool updateGrid = false;
+    if (m_policy->fit(min, max, low, high))
+        updateGrid = adjustAxis(low, high, AutoScale);
+
+    m_policy->record(updateGrid);
+    return updateGrid;
+}
+
+bool Axis::adjustAxis(qreal min, qreal max, UpdateAdjust updateAdjust)
+{
+    bool updateGrid = false;
+    if (updateAdjust == Forced || m_autoScale) {
+        const int MinTicks = 4;
+        qreal grossStep = (max - min) / MinTicks;
+        qreal step = pow(10.0, floor(log10(grossStep)));
+
+        if (qIsNaN(step) || step == 0.0)
+            return false;
+
+        if ((5 * step) < grossStep)
+            step *= 5;
+        else if ((2 * step) < grossStep)
+            step *= 2;
+
+        m_adjustSettings.numTicks = int(ceil(max / step) - floor(min / step));
+        if (m_adjustSettings.numTicks < MinTicks)
+            m_adjustSettings.numTicks = MinTicks;
+        min = floor(min / step) * step;
+        max = ceil(max / step) * step;
+
+        if (m_adjustSettings.min != min ||
+                m_adjustSettings.max != max) {
+            updateGrid = true;
+
+            m_adjustSettings.min = min;
+            m_adjustSettings.max = max;
+        }
+    }
+
+    return updateGrid;
+}
+
+bool Axis::autoScale() const
+{
+    return m_autoScale;
+}
+
+void Axis::setAutoScale(bool autoScale)
+{
+    if (m_autoScale != autoScale) {
+        m_autoScale = autoScale;
+
+        emit autoScaleChanged(autoScale);
+    }
+}
+
+QColor Axis::lineColor() const
+{
+    return m_lineColor;
+}
+
+void Axis::setLineColor(const QColor &lineColor)
+{
+    if (m_lineColor != lineColor) {
+        m_lineColor = lineColor;
+        emit minMaxChanged();
+    }
+}
+
+bool Axis::visble() const
+{
+    return m_visble;
+}
+
+void Axis::setVisble(bool visble)
+{
+    if (m_visble != visble) {
+        m_visble = visble;
+
+        emit visbleChanged(visble);
+    }
+}
+
+qreal Axis::min() const
+{
+    return m_adjustSettings.min;
+}
+
+void Axis::setMin(qreal value)
+{
+    if (m_adjustSettings.min != value && !m_autoScale) {
+        if (adjustAxis(value, m_adjustSettings.max, Forced))
+            emit minMaxChanged();
+    }
+}
+
+qreal Axis::max() const
+{
+    return m_adjustSettings.max;
+}
+
+void Axis::setMax(qreal value)
+{
+    if (m_adjustSettings.max != value && !m_autoScale) {
+        if (adjustAxis(m_adjustSettings.min, value, Forced))
+            emit minMaxChanged();
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef AXIS_H
+#define AXIS_H
+
+#include <QColor>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class AutoScalePolicy;
+
+class Axis : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(Axis)
+
+public:
+    explicit Axis(QObject* parent = 0);
+    virtual ~Axis();
+
+    bool visble() const;
+    void setVisble(bool visble);
+
+    qreal min() const;
+    void setMin(qreal value);
+    qreal max() const;
+    void setMax(qreal value);
+    bool autoScale() const;
+    void setAutoScale(bool autoScale);
+
+    QColor lineColor() const;
+    void setLineColor(const QColor &lineColor);
+
+    enum UpdateAdjust { AutoScale, Forced };
+
+    void adjust(qreal min, qreal max,
+                UpdateAdjust updateAdjust = AutoScale) {
+        adjustAxis(min, max, updateAdjust);
+    }
+    bool autoScaleAdjust(qreal min, qreal max);
+
+    AutoScalePolicy* autoScalePolicy() const { return m_policy; }
+    void setAutoScalePolicy(AutoScalePolicy *policy);
+
+    int numTicks() const { return m_adjustSettings.numTicks; }
+    qreal span() const { return m_adjustSettings.max - m_adjustSettings.min; }
+
+    void clearMaxTickLabelWidth() { m_maxTickLabelWidth = 0; }
+    void setMaxTickLabelWidth(int width) {
+        if (m_maxTickLabelWidth < width)
+            m_maxTickLabelWidth = width;
+    }
+    int maxTickLabelWidth() const { return m_maxTickLabelWidth; }
+
+signals:
+    void visbleChanged(bool visble);
+    void autoScaleChanged(bool autoScale);
+    void minMaxChanged();
+
+private:
+    bool adjustAxis(qreal min, qreal max, UpdateAdjust updateAdjust);
+
+    struct AdjustSettings {
+        qreal min;
+        qreal max;
+        int numTicks;
+    } m_adjustSettings;
+
+    bool m_visble;
+    bool m_autoScale;
+    QString m_caption;
+    QColor m_lineColor;
+    int m_maxTickLabelWidth;
+    AutoScalePolicy *m_policy;
+};
+
+class Axes
+{
+
+public:
+    explicit Axes(QObject* parent = 0);
+    explicit Axes(int numAxes, QObject* parent = 0);
+    ~Axes();
+
+    Axis* xAxis() { return  m_xAxis; }
+    QVector<Axis* >& yAxes() { return m_yAxes; }
+    Axis* yAxes(int key) { return m_yAxes[key]; }
+
+private:
+    Axis* m_xAxis;
+    QVector<Axis* > m_yAxes;
+};
+
+#endif // AXIS_H
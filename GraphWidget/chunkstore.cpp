@@ -0,0 +1,264 @@
+#include "chunkstore.h"
+
+#include <limits>
+
+using namespace std;
+
+qint64 SpillFile::write(const double *x, const double *y, qint64 bytes)
+{
+    if (!m_file.isOpen() && !m_file.open())
+        return -1;
+
+    QMultiHash<qint64, qint64>::iterator it = m_free.find(2 * bytes);
+    qint64 offset = (it != m_free.end()) ? it.value() : m_size;
+    if (!m_file.seek(offset)
+            || m_file.write(reinterpret_cast<const char *>(x), bytes) != bytes
+            || m_file.write(reinterpret_cast<const char *>(y), bytes) != bytes)
+        return -1;
+
+    if (it != m_free.end())
+        m_free.erase(it);
+    else
+        m_size += 2 * bytes;
+    m_used += 2 * bytes;
+    return offset;
+}
+
+bool SpillFile::read(qint64 offset, double *x, double *y, qint64 bytes)
+{
+    return m_file.seek(offset)
+            && m_file.read(reinterpret_cast<char *>(x), bytes) == bytes
+            && m_file.read(reinterpret_cast<char *>(y), bytes) == bytes;
+}
+
+void SpillFile::release(qint64 offset, qint64 bytes)
+{
+    m_used -= 2 * bytes;
+    if (m_used > 0) {
+        m_free.insert(2 * bytes, offset);
+        return;
+    }
+
+    // 使用中の領域がなくなったらファイルを空にする
+    m_free.clear();
+    m_size = 0;
+    if (m_file.isOpen())
+        m_file.resize(0);
+}
+
+ChunkStore::ChunkStore(qint64 memoryBudget, int chunkSize)
+    : m_memoryBudget(memoryBudget),
+      m_chunkSize(qMax(1024, chunkSize)),
+      m_count(0),
+      m_monotonic(true),
+      m_lastX(-numeric_limits<double>::max()),
+      m_residentBytes(0),
+      m_useTick(0),
+      m_currentChunk(-1),
+      m_discarded(0)
+{
+}
+
+void ChunkStore::setMemoryBudget(qint64 bytes)
+{
+    m_memoryBudget = bytes;
+    evict();
+}
+
+void ChunkStore::append(double x, double y)
+{
+    if (m_chunks.isEmpty() || m_chunks.last().summary.count == m_chunkSize) {
+        Chunk chunk;
+        chunk.summary.xMin = chunk.summary.yMin = numeric_limits<double>::max();
+        chunk.summary.xMax = chunk.summary.yMax = -numeric_limits<double>::max();
+        chunk.summary.count = 0;
+        chunk.x.reserve(m_chunkSize);
+        chunk.y.reserve(m_chunkSize);
+        chunk.fileOffset = -1;
+        chunk.lastUse = ++m_useTick;
+        chunk.resident = true;
+        m_chunks.append(chunk);
+        m_residentBytes += chunkBytes();
+        evict();
+    }
+
+    Chunk &chunk = m_chunks.last();
+    chunk.x.append(x);
+    chunk.y.append(y);
+
+    Summary &summary = chunk.summary;
+    summary.xMin = qMin(summary.xMin, x);
+    summary.xMax = qMax(summary.xMax, x);
+    summary.yMin = qMin(summary.yMin, y);
+    summary.yMax = qMax(summary.yMax, y);
+    summary.count++;
+    m_count++;
+
+    if (x < m_lastX)
+        m_monotonic = false;
+    m_lastX = x;
+}
+
+void ChunkStore::clear()
+{
+    releaseSpilled();
+    m_chunks.clear();
+    m_count = 0;
+    m_monotonic = true;
+    m_lastX = -numeric_limits<double>::max();
+    m_residentBytes = 0;
+    m_currentChunk = -1;
+    m_discarded = 0;
+}
+
+void ChunkStore::releaseSpilled()
+{
+    if (!m_spillFile)
+        return;
+
+    foreach (const Chunk &chunk, m_chunks) {
+        if (chunk.fileOffset >= 0)
+            m_spillFile->release(chunk.fileOffset, qint64(chunk.summary.count) * qint64(sizeof(double)));
+    }
+}
+
+int ChunkStore::span(int index, int count, const double **x, const double **y)
+{
+    // 1 チャンク内で連続している範囲だけを返す
+    const Chunk &chunk = resident(index / m_chunkSize);
+    int offset = index % m_chunkSize;
+    *x = chunk.x.constData() + offset;
+    *y = chunk.y.constData() + offset;
+    return qMin(count, chunk.summary.count - offset);
+}
+
+bool ChunkStore::visibleChunks(double xMin, double xMax, int &firstChunk, int &lastChunk) const
+{
+    firstChunk = -1;
+    lastChunk = -1;
+    for (int n = 0; n < m_chunks.size(); ++n) {
+        const Summary &summary = m_chunks[n].summary;
+        if (summary.xMax < xMin || summary.xMin > xMax)
+            continue;
+        if (firstChunk < 0)
+            firstChunk = n;
+        lastChunk = n;
+    }
+    return firstChunk >= 0;
+}
+
+bool ChunkStore::minMax(double &xMin, double &xMax, double &yMin, double &yMax) const
+{
+    xMin = yMin = numeric_limits<double>::max();
+    xMax = yMax = -numeric_limits<double>::max();
+    foreach (const Chunk &chunk, m_chunks) {
+        xMin = qMin(xMin, chunk.summary.xMin);
+        xMax = qMax(xMax, chunk.summary.xMax);
+        yMin = qMin(yMin, chunk.summary.yMin);
+        yMax = qMax(yMax, chunk.summary.yMax);
+    }
+    return m_count > 0;
+}
+
+void ChunkStore::prefetch(int chunk)
+{
+    if (chunk < m_discarded || chunk >= m_chunks.size())
+        return;
+
+    if (!m_chunks[chunk].resident)
+        load(chunk);
+    m_chunks[chunk].lastUse = ++m_useTick;
+}
+
+int ChunkStore::discardBefore(double x)
+{
+    int discarded = 0;
+    while (m_discarded < m_chunks.size() - 1 && m_chunks[m_discarded].summary.xMax < x) {
+        Chunk &chunk = m_chunks[m_discarded];
+        if (chunk.resident)
+            m_residentBytes -= chunkBytes();
+        if (chunk.fileOffset >= 0 && m_spillFile)
+            m_spillFile->release(chunk.fileOffset, qint64(chunk.summary.count) * qint64(sizeof(double)));
+        chunk.x = QVector<double>();
+        chunk.y = QVector<double>();
+        chunk.fileOffset = -1;
+        chunk.resident = false;
+        if (m_currentChunk == m_discarded)
+            m_currentChunk = -1;
+        m_discarded++;
+        discarded++;
+    }
+    return discarded;
+}
+
+const ChunkStore::Chunk &ChunkStore::resident(int chunk)
+{
+    Q_ASSERT(chunk >= m_discarded);
+    if (chunk != m_currentChunk) {
+        m_currentChunk = chunk;
+        if (!m_chunks[chunk].resident)
+            load(chunk);
+        m_chunks[chunk].lastUse = ++m_useTick;
+    }
+    return m_chunks[chunk];
+}
+
+bool ChunkStore::load(int chunk)
+{
+    Chunk &c = m_chunks[chunk];
+    qint64 bytes = qint64(c.summary.count) * qint64(sizeof(double));
+
+    c.x.resize(c.summary.count);
+    c.y.resize(c.summary.count);
+    if (!m_spillFile->read(c.fileOffset, c.x.data(), c.y.data(), bytes)) {
+        qWarning("ChunkStore: failed to load chunk %d", chunk);
+        c.x.fill(0.0);
+        c.y.fill(0.0);
+    }
+
+    c.resident = true;
+    c.lastUse = ++m_useTick;
+    m_residentBytes += chunkBytes();
+    evict();
+    return true;
+}
+
+bool ChunkStore::spill(Chunk &chunk)
+{
+    if (chunk.fileOffset >= 0)  // 書き込み済み (チャンクは不変)
+        return true;
+
+    if (!m_spillFile) // 共有されていなければ自分用に作る
+        m_spillFile = QSharedPointer<SpillFile>(new SpillFile);
+
+    qint64 bytes = qint64(chunk.summary.count) * qint64(sizeof(double));
+    chunk.fileOffset = m_spillFile->write(chunk.x.constData(), chunk.y.constData(), bytes);
+    return chunk.fileOffset >= 0;
+}
+
+void ChunkStore::evict()
+{
+    while (m_residentBytes > m_memoryBudget) {
+        // 末尾 (書き込み中) と参照中のチャンクを除いて最も古く使われたものを退避
+        int victim = -1;
+        for (int n = 0; n < m_chunks.size() - 1; ++n) {
+            const Chunk &chunk = m_chunks[n];
+            if (!chunk.resident || n == m_currentChunk)
+                continue;
+            if (victim < 0 || chunk.lastUse < m_chunks[victim].lastUse)
+                victim = n;
+        }
+        if (victim < 0)
+            return;
+
+        Chunk &chunk = m_chunks[victim];
+        if (!spill(chunk)) {
+            qWarning("ChunkStore: failed to spill chunk %d", victim);
+            return;
+        }
+        chunk.x = QVector<double>();
+        chunk.y = QVector<double>();
+        chunk.resident = false;
+        m_residentBytes -= chunkBytes();
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <QMultiHash>
+#include <QSharedPointer>
+#include <QTemporaryFile>
+#include <QVector>
+
+// 複数のストアで共有する退避ファイル
+// (系列ごとにファイルを開くと系列数だけファイル記述子を使うため)
+class SpillFile
+{
+    Q_DISABLE_COPY(SpillFile)
+
+public:
+    SpillFile() : m_size(0), m_used(0) {}
+
+    // x, y を続けて書き込み、その位置を返す (失敗時は -1)
+    qint64 write(const double *x, const double *y, qint64 bytes);
+    bool read(qint64 offset, double *x, double *y, qint64 bytes);
+    // 不要になった領域は同じ大きさの書き込みで再利用する
+    void release(qint64 offset, qint64 bytes);
+
+private:
+    QTemporaryFile m_file;
+    qint64 m_size;
+    qint64 m_used;
+    QMultiHash<qint64, qint64> m_free;  // 大きさ -> 位置
+};
+
+class ChunkStore
+{
+    Q_DISABLE_COPY(ChunkStore)
+
+public:
+    struct Summary {
+        double xMin;
+        double xMax;
+        double yMin;
+        double yMax;
+        int count;
+    };
+
+    explicit ChunkStore(qint64 memoryBudget = 256 * 1024 * 1024, int chunkSize = 65536);
+    ~ChunkStore() { releaseSpilled(); }
+
+    // 退避を始める前に設定する (未設定なら最初の退避時に専用のファイルを作る)
+    void setSpillFile(const QSharedPointer<SpillFile> &file) { m_spillFile = file; }
+
+    qint64 memoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(qint64 bytes);
+    qint64 residentBytes() const { return m_residentBytes; }
+
+    int count() const { return m_count; }
+    bool isMonotonic() const { return m_monotonic; }
+    // これより前のサンプルは破棄済み (要約だけが残る)
+    int firstIndex() const { return m_discarded * m_chunkSize; }
+    void append(double x, double y);
+    void clear();
+
+    // 退避済みのチャンクは必要になった時点で読み戻す
+    double x(int index) { return resident(index / m_chunkSize).x[index % m_chunkSize]; }
+    double y(int index) { return resident(index / m_chunkSize).y[index % m_chunkSize]; }
+    int span(int index, int count, const double **x, const double **y);
+
+    int chunkSize() const { return m_chunkSize; }
+    int chunkCount() const { return m_chunks.size(); }
+    const Summary& summary(int chunk) const { return m_chunks[chunk].summary; }
+    bool isResident(int chunk) const { return m_chunks[chunk].resident; }
+
+    bool visibleChunks(double xMin, double xMax, int &firstChunk, int &lastChunk) const;
+    bool minMax(double &xMin, double &xMax, double &yMin, double &yMax) const;
+    void prefetch(int chunk);
+    // X が x より前のチャンクを先頭から破棄する (書き込み中のチャンクは残す)
+    int discardBefore(double x);
+
+private:
+    struct Chunk {
+        Summary summary;
+        QVector<double> x;
+        QVector<double> y;
+        qint64 fileOffset;
+        quint64 lastUse;
+        bool resident;
+    };
+
+    const Chunk& resident(int chunk);
+    qint64 chunkBytes() const { return 2 * qint64(m_chunkSize) * qint64(sizeof(double)); }
+    bool load(int chunk);
+    bool spill(Chunk &chunk);
+    void evict();
+    void releaseSpilled();
+
+    qint64 m_memoryBudget;
+    int m_chunkSize;
+    int m_count;
+    bool m_monotonic;
+    double m_lastX;
+    qint64 m_residentBytes;
+    quint64 m_useTick;
+    int m_currentChunk;
+    int m_discarded;
+    QVector<Chunk> m_chunks;
+    QSharedPointer<SpillFile> m_spillFile;
+};
+
+#endif // CHUNKSTORE_H
@@ -0,0 +1,31 @@
+#ifndef COLUMNPROVIDER_H
+#define COLUMNPROVIDER_H
+
+#include <QObject>
+
+// 列を連続した配列で保持しているモデルが任意で実装するインターフェース
+//
+//   class SampleModel : public QAbstractTableModel, public ColumnProvider
+//   {
+//       Q_OBJECT
+//       Q_INTERFACES(ColumnProvider)
+//       ...
+//   };
+//
+// Graph は qobject_cast で検出し、QVariant を介さずにブロック単位で読む。
+class ColumnProvider
+{
+
+public:
+    virtual ~ColumnProvider() {}
+
+    // column の first 行から連続して読める値の先頭を *data に返し、その個数
+    // (count 以下) を返す。連続した配列で返せない場合は 0 を返す
+    // (その範囲は index().data() で読まれる)。
+    virtual int columnSpan(int column, int first, int count, const double **data) const = 0;
+};
+
+#define ColumnProvider_iid "org.graph.ColumnProvider"
+Q_DECLARE_INTERFACE(ColumnProvider, ColumnProvider_iid)
+
+#endif // COLUMNPROVIDER_H
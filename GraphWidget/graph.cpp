@@ -8,35 +8,86 @@
 
 //#include "siPrefixes.h"
 #include "graph.h"
+#include "trigger.h"
+#include "rollup.h"
+#include "autoscale.h"
+#include "snapshot.h"
+#include "alloccounter.h"
 
 using namespace std;
 
 Graph::Graph(QWidget *parent)
     : QWidget(parent),
-      m_visbleYAxesCount(1)
+      m_visbleYAxesCount(1),
+      m_model(0),
+      m_trigger(0),
+      m_frameFirst(-1),
+      m_frameLast(-1),
+      m_frameOrigin(0.0),
+      m_triggeredRow(-1),
+      m_overviewFrame(false),
+      m_appendedRows(0),
+      m_fullResolutionSpan(0.0),
+      m_memoryBudget(0),
+      m_rowOffset(0),
+      m_viewCenter(0.0),
+      m_viewDirection(0),
+      m_prefetchPending(false),
+      m_crosshairEnabled(false),
+      m_ingest(0),
+      m_frameBudget(16),
+      m_quality(FullQuality),
+      m_slowFrames(0),
+      m_fastFrames(0),
+      m_slowAppends(0),
+      m_fastAppends(0)
 {
+    m_spillFile = QSharedPointer<SpillFile>(new SpillFile);
+
     setBackgroundRole(QPalette::Dark);
     setAutoFillBackground(true);
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 
     this->disconnect();
 
+    m_series = new SeriesRegistry(this);
     m_axes = new Axes(0, this);
+    m_renderer = new Renderer(m_series, m_axes);
+
+    connect(m_series, &SeriesRegistry::changed, this, &Graph::onSeriesChange);
+
+    m_resizeTimer.setSingleShot(true);
+    m_resizeTimer.setInterval(ResizeDelay);
+    connect(&m_resizeTimer, &QTimer::timeout, this, &Graph::refreshPixmap);
 
     connect(xAxis(), &Axis::visbleChanged, this, &Graph::onXAxesVisbleChange);
     connect(xAxis(), &Axis::autoScaleChanged, this, &Graph::onAutoScaleUpdate);
     connect(xAxis(), &Axis::minMaxChanged, this, &Graph::onRefresh);
 }
 
-void Graph::setPlot(Plot* plot, Axis* yAxis)
+Graph::~Graph()
 {
-    m_plotMap.insert(yAxis, plot);
-    m_axes->yAxes().append(yAxis);
+    delete m_renderer;
+}
 
-    // Plot
-    connect(plot, &Plot::refreshed, this, &Graph::onRefresh);
-    connect(plot, &Plot::autoScaleUpdated, this, &Graph::onAutoScaleUpdate);
-    connect(plot, &Plot::dataUpdated, this, &Graph::onDataUpdate);
+void Graph::setPlot(Plot plot, Axis* yAxis)
+{
+    if (!plot.isValid())
+        return;
+
+    int axisIndex = m_axes->yAxes().indexOf(yAxis);
+    if (axisIndex < 0)
+        axisIndex = addYAxis(yAxis);
+    m_series->setAxisIndex(plot.id(), axisIndex);
+
+    // 多数の系列を続けて登録しても再描画は 1 回にまとめる
+    m_series->markChanged(SeriesRegistry::Refresh);
+}
+
+int Graph::addYAxis(Axis *yAxis)
+{
+    int axisIndex = m_axes->yAxes().size();
+    m_axes->yAxes().append(yAxis);
 
     // Y Axis
     connect(yAxis, &Axis::visbleChanged, this, &Graph::onYAxesVisbleChange);
@@ -48,8 +99,7 @@ void Graph::setPlot(Plot* plot, Axis* yAxis)
         if (yAxis->visble())
            m_visbleYAxesCount++;
     }
-
-    refreshPixmap();
+    return axisIndex;
 }
 
 void Graph::setPlot(int column, Axis *yAxis)
@@ -62,10 +112,18 @@ Axis *Graph::xAxis()
     return m_axes->xAxis();
 }
 
-void Graph::paintEvent(QPaintEvent * /* event */)
+void Graph::paintEvent(QPaintEvent *event)
 {
     QStylePainter painter(this);
-    painter.drawPixmap(0, 0, m_pixmap);
+    bool resizing = (m_pixmap.size() != size());
+    if (resizing) // 描き直すまでは前の画を引き伸ばして表示
+        painter.drawPixmap(rect(), m_pixmap);
+    else
+        painter.drawPixmap(event->rect(), m_pixmap, event->rect());
+
+    // カーソル表示はピクセルマップに描かず毎回上に重ねる
+    if (m_crosshairEnabled && !resizing)
+        drawCrosshair(&painter);
 
     if (hasFocus()) {
         QStyleOptionFocusRect option;
@@ -77,9 +135,119 @@ void Graph::paintEvent(QPaintEvent * /* event */)
 
 void Graph::resizeEvent(QResizeEvent * /* event */)
 {
+    if (m_pixmap.isNull()) {
+        refreshPixmap();
+        return;
+    }
+
+    // ドラッグ中は描き直さず、止まってから 1 回だけ全体を描く
+    m_resizeTimer.start();
+    update();
+}
+
+void Graph::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!m_crosshairEnabled) {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+
+    m_cursorPos = event->pos();
+    updateHover();
+    update();
+}
+
+void Graph::leaveEvent(QEvent *event)
+{
+    if (m_crosshairEnabled && !m_hoverPoints.isEmpty()) {
+        m_hoverPoints.clear();
+        m_cursorPos = QPoint(-1, -1);
+        update();
+    }
+    QWidget::leaveEvent(event);
+}
+
+void Graph::setCrosshairEnabled(bool enabled)
+{
+    if (m_crosshairEnabled == enabled)
+        return;
+
+    m_crosshairEnabled = enabled;
+    setMouseTracking(enabled);
+    m_hoverPoints.clear();
+    m_cursorPos = QPoint(-1, -1);
+    m_renderer->setPixelIndexEnabled(enabled);
+
+    // 画素列インデックスを作り直すため全体を描き直す
     refreshPixmap();
 }
 
+void Graph::updateHover()
+{
+    m_hoverPoints.clear();
+    QRect rect = m_renderer->rect();
+    if (!rect.isValid() || !rect.contains(m_cursorPos))
+        return;
+
+    Axis* xAxis = m_axes->xAxis();
+    const QVector<Axis*> &yAxes = m_axes->yAxes();
+    double xOrigin = isTriggerMode() ? m_frameOrigin : 0.0;
+    double xScale = (rect.width() - 1) / xAxis->span();
+    double cursorX = xAxis->min() + xOrigin + (m_cursorPos.x() - rect.left()) / xScale;
+
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        int axis = plot.axisIndex();
+        if (axis < 0 || !plot.visble())
+            continue;
+
+        // X が単調なら二分探索、そうでなければ描画時に作った画素列インデックスを引く
+        int index = plot.isXMonotonic() ? plot.nearest(cursorX)
+                                        : m_renderer->nearestByPixel(id, m_cursorPos.x() - rect.left());
+        if (index < 0)
+            continue;
+        if (isTriggerMode() && (index < m_frameFirst || index > m_frameLast))
+            continue;
+
+        Axis* yAxis = yAxes[axis];
+        HoverPoint point;
+        point.id = id;
+        point.index = index;
+        point.x = plot.xData(index);
+        point.y = plot.yData(index);
+        point.pos = QPointF(rect.left() + ((point.x - xOrigin - xAxis->min()) * xScale),
+                            rect.bottom() - ((point.y - yAxis->min()) * (rect.height() - 1)
+                                               / yAxis->span()));
+        m_hoverPoints.append(point);
+    }
+
+    emit crosshairMoved(cursorX - xOrigin);
+}
+
+void Graph::drawCrosshair(QPainter *painter)
+{
+    QRect rect = m_renderer->rect();
+    if (!rect.isValid() || !rect.contains(m_cursorPos))
+        return;
+
+    painter->save();
+    painter->setClipRect(rect.adjusted(+1, +1, -1, -1));
+    painter->setPen(QPen(palette().light().color(), 1, Qt::DashLine));
+    painter->drawLine(m_cursorPos.x(), rect.top(), m_cursorPos.x(), rect.bottom());
+
+    // 各系列の最寄り点にマーカーと値を表示
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    foreach (const HoverPoint &point, m_hoverPoints) {
+        Plot plot(m_series, point.id);
+        painter->setPen(QPen(plot.lineColor(), 1.0));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawEllipse(point.pos, 3.0, 3.0);
+        painter->drawText(point.pos + QPointF(6, -4),
+                          QString("%1: %2").arg(plot.section()).arg(point.y));
+    }
+    painter->restore();
+}
+
 void Graph::onRefresh()
 {
     refreshPixmap();
@@ -87,16 +255,39 @@ void Graph::onRefresh()
 
 void Graph::onAutoScaleUpdate()
 {
+    // 全系列を 1 回走査して軸ごとの範囲を求める
+    const QVector<Axis*> &yAxes = m_axes->yAxes();
+    qreal xMin = numeric_limits<qreal>::max();
+    qreal xMax = numeric_limits<qreal>::min();
+    m_axisMin.fill(numeric_limits<qreal>::max(), yAxes.size());
+    m_axisMax.fill(numeric_limits<qreal>::min(), yAxes.size());
+    qreal* yMin = m_axisMin.data();
+    qreal* yMax = m_axisMax.data();
+
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        int axis = plot.axisIndex();
+        if (axis < 0)
+            continue;
+
+        QPointF minData = plot.minData();
+        QPointF maxData = plot.maxData();
+        xMin = qMin(xMin, minData.x());
+        xMax = qMax(xMax, maxData.x());
+        yMin[axis] = qMin(yMin[axis], minData.y());
+        yMax[axis] = qMax(yMax[axis], maxData.y());
+    }
+
     bool updateGrid = false;
     Axis* xAxis = m_axes->xAxis();
-    if (xAxis->autoScale()) {
-        if (xAxis->autoScaleAdjustX(m_plotMap.values()))
+    if (xAxis->autoScale() && !isTriggerMode()) { // トリガモードの X はフレームで決まる
+        if (xAxis->autoScaleAdjust(xMin, xMax))
             updateGrid = true;
     }
 
-    foreach(Axis* yAxes, m_axes->yAxes()) {
-        if (yAxes->autoScale()) {
-            if (yAxes->autoScaleAdjustY(m_plotMap.values(yAxes)))
+    for (int axis = 0; axis < yAxes.size(); ++axis) {
+        if (yAxes[axis]->autoScale()) {
+            if (yAxes[axis]->autoScaleAdjust(yMin[axis], yMax[axis]))
                 updateGrid = true;
         }
     }
@@ -109,9 +300,39 @@ void Graph::onAutoScaleUpdate()
 
 void Graph::onDataUpdate()
 {
-    QPainter painter(&m_pixmap);
-    drawCurves(&painter);
-    update();
+    // 追記のたびに QPainter を作ると開始とクリップの設定で確保が走るため、
+    // 次の全体再描画までは同じものを使い続ける (最初の 1 回だけ開始の分を数える)
+    QElapsedTimer timer;
+    timer.start();
+    quint64 allocations = AllocCounter::count();
+    if (!m_dataPainter.isActive()) {
+        m_dataPainter.begin(&m_pixmap);
+        m_renderer->clipCurves(&m_dataPainter);
+    }
+    syncRenderer();
+    m_renderer->drawCurves(&m_dataPainter, false);
+    allocations = AllocCounter::count() - allocations;
+    qint64 nsecs = timer.nsecsElapsed();
+#ifdef GRAPH_ALLOC_COUNT
+    if (allocations > 0)
+        qDebug("Graph: %llu allocations in incremental frame", allocations);
+#else
+    Q_UNUSED(allocations);
+#endif
+
+    if (m_crosshairEnabled && underMouse()) {
+        // 新しいデータでカーソル位置の値が変わるため表示全体を描き直す
+        updateHover();
+        update();
+    }
+    else if (m_pixmap.size() == size()) {
+        update(m_renderer->dirtyRect());
+    }
+    else {
+        update();
+    }
+
+    adjustQuality(nsecs, true);
 }
 
 void Graph::onYAxesVisbleChange(bool visble)
@@ -125,49 +346,51 @@ void Graph::onXAxesVisbleChange(bool /*visible*/)
     refreshPixmap();
 }
 
+void Graph::onSeriesChange(int changes)
+{
+    if (changes & SeriesRegistry::AutoScale)
+        onAutoScaleUpdate();
+    refreshPixmap();
+}
+
 void Graph::onDataChange(const QModelIndex &topLeft, const QModelIndex &bottomRight,
                          const QVector<int> &/*roles*/)
 {
+    if (m_memoryBudget > 0 && topLeft.row() < m_appendedRows) {
+        qWarning("Graph: changes to stored rows are ignored while a memory budget is set");
+        Q_ASSERT_X(false, "Graph::onDataChange", "memory budget requires append-only models");
+    }
+
     for (int column = topLeft.column(); column <= bottomRight.column(); column++) {
-        if (column != 0) { // Y Axis
-            for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
-                m_plots.value(column)->recalculateMinMaxAllData(true);
-            }
-        }
+        Plot plot = this->plot(column);
+        if (column != 0 && plot.isValid()) // Y Axis
+            plot.recalculateMinMaxAllData(true);
     }
 
     onAutoScaleUpdate();
     onRefresh();
 }
 
-void Graph::onRowsInsert(const QModelIndex &parent, int first, int last)
+void Graph::onRowsInsert(const QModelIndex &/*parent*/, int first, int last)
 {
     bool minmaxChange = false;
-    bool isAppendMode = true;
-
-    QMapIterator<int, Plot*> i(m_plots);
-    while (i.hasNext()) {
-        i.next();
-        int column = i.key();
-        if (column != 0) { // Y Axis
-            if ((first +1) != i.value()->count())
-                isAppendMode = false;
-
-            for (int row = first; row <= last; row++) {
-                QModelIndex yIndex = m_model->index(row, column, parent);
-                QModelIndex xIndex = m_model->index(row, 0, parent);
-                minmaxChange += i.value()->calculateMinMaxData(yIndex, xIndex);
-            }
-        }
-    }
+    bool isAppendMode = ((last + 1) == m_model->rowCount());
+
+    for (int id = 0; id < m_series->count(); ++id)
+        minmaxChange += Plot(m_series, id).calculateMinMaxRows(first, last);
 
     if (isAppendMode) {
+        notifyAppended(first, last);
         if (minmaxChange)
             onAutoScaleUpdate();
         else
             onDataUpdate();
     }
     else {
+        if (m_memoryBudget > 0) {
+            qWarning("Graph: rows inserted before the end are not stored while a memory budget is set");
+            Q_ASSERT_X(false, "Graph::onRowsInsert", "memory budget requires append-only models");
+        }
         if (minmaxChange)
             onAutoScaleUpdate();
         onRefresh();
@@ -177,239 +400,242 @@ void Graph::onRowsInsert(const QModelIndex &parent, int first, int last)
 
 void Graph::onRowsAboutToBeRemove(const QModelIndex &parent, int first, int last)
 {
-    QMapIterator<int, Plot*> i(m_plots);
-    while (i.hasNext()) {
-        i.next();
-        int column = i.key();
-        if (column != 0) { // Y Axis
-            for (int row = first; row <= last; row++) {
-                QModelIndex yIndex = m_model->index(row, column, parent);
-                QModelIndex xIndex = m_model->index(row, 0, parent);
-                i.value()->checkMinMaxDeleteData(yIndex, xIndex);
-            }
+    if (m_memoryBudget > 0) // ストア側にデータが残るため範囲は変わらない
+        return;
+
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        int column = plot.section();
+        for (int row = first; row <= last; row++) {
+            QModelIndex yIndex = m_model->index(row, column, parent);
+            QModelIndex xIndex = m_model->index(row, 0, parent);
+            plot.checkMinMaxDeleteData(yIndex, xIndex);
         }
     }
 }
 
-void Graph::onRowsRemove(const QModelIndex &/*parent*/, int /*first*/, int /*last*/)
+void Graph::onRowsRemove(const QModelIndex &/*parent*/, int first, int last)
 {
-    bool minmaxChange = false;
+    if (m_memoryBudget > 0) {
+        // 取り込み済みの行はストアに残るので、以降の行番号のずれだけを記録する
+        int removed = qMin(last, m_appendedRows - 1) - first + 1;
+        if (removed > 0) {
+            m_appendedRows -= removed;
+            m_rowOffset += removed;
+        }
+        return;
+    }
 
-    QMapIterator<int, Plot*> i(m_plots);
-    while (i.hasNext()) {
-        i.next();
-        int column = i.key();
-        if (column != 0) { // Y Axis
-            minmaxChange +=i.value()->recalculateMinMaxAllData();
+    // 先頭から古い行を捨てる (スライディングウィンドウ) 場合は以降のサンプルが続いている
+    if (first > 0)
+        emit samplesReset();
+
+    // トリガの走査位置と表示中のフレームを削除後の行番号に合わせる
+    int removed = last - first + 1;
+    if (m_trigger)
+        m_trigger->removeRows(first, removed);
+    if (m_frameFirst >= 0) {
+        if (m_frameFirst <= last && m_frameLast >= first) {
+            m_frameFirst = m_frameLast = -1;
+        }
+        else if (m_frameFirst > last) {
+            m_frameFirst -= removed;
+            m_frameLast -= removed;
         }
     }
 
+    bool minmaxChange = false;
+
+    for (int id = 0; id < m_series->count(); ++id)
+        minmaxChange += Plot(m_series, id).recalculateMinMaxAllData();
+
    if (minmaxChange)
        onAutoScaleUpdate();
 
+    m_appendedRows = qMin(m_appendedRows, m_model->rowCount());
     onRefresh();
 }
 
 void Graph::onResetModel()
 {
-    QMapIterator<int, Plot*> i(m_plots);
-    while (i.hasNext()) {
-        i.next();
-        i.value()->clear();
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        plot.clear();
+        if (plot.rollup())
+            plot.rollup()->clear();
+        if (plot.store())
+            plot.store()->clear();
     }
 
+    if (m_trigger)
+        m_trigger->reset();
+    m_frameFirst = m_frameLast = -1;
+    m_appendedRows = 0;
+    m_renderer->setPixelIndexEnabled(m_crosshairEnabled);
+    m_hoverPoints.clear();
+
+    m_axes->xAxis()->autoScalePolicy()->reset();
+    foreach (Axis* yAxis, m_axes->yAxes())
+        yAxis->autoScalePolicy()->reset();
+    m_rowOffset = 0;
+
     onAutoScaleUpdate();
     onRefresh();
+    emit samplesReset();
 }
 
 void Graph::refreshPixmap()
 {
-    m_pixmap = QPixmap(size());
+    QElapsedTimer timer;
+    timer.start();
+
+    m_resizeTimer.stop();
+    if (m_dataPainter.isActive())
+        m_dataPainter.end();
+    if (m_pixmap.size() != size()) // 大きさが同じなら使い回す
+        m_pixmap = QPixmap(size());
     m_pixmap.fill(Qt::black);
 
     QPainter painter(&m_pixmap);
     painter.initFrom(this);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    drawGrid(&painter);
-    drawCurves(&painter);
-    update();
+    painter.setRenderHint(QPainter::Antialiasing, m_quality < NoAntialiasing);
+    syncRenderer();
+    m_renderer->drawGrid(&painter, size());
+    m_renderer->drawCurves(&painter);
+    painter.end();
+    if (m_crosshairEnabled && underMouse())
+        updateHover();  // 軸の範囲が変わっても表示中の値と位置を合わせる
+
+    if (m_overviewFrame) {
+        // 要約で描いた 1 枚を先に表示してから全サンプルで描き直す
+        m_overviewFrame = false;
+        m_renderer->setOverviewOnly(false);
+        repaint();
+        QTimer::singleShot(0, this, &Graph::onOverviewShown);
+    }
+    else {
+        update();
+    }
+
+    schedulePrefetch();
+    adjustQuality(timer.nsecsElapsed(), false);
 }
 
-void Graph::drawGrid(QPainter *painter)
+void Graph::setFrameBudget(int msecs)
 {
-    QFontMetrics fm(font());
-
-    QVector<QString> labels;
-   // SiPrefixes siLabel;
-    int yAxisMargin = 0;
-    foreach (Axis* yAxis, m_axes->yAxes()) {
-        yAxis->clearMaxTickLabelWidth();
-        if (yAxis->visble()) {
-            for (int j = 0; j <= yAxis->numTicks(); ++j) {
-                double labelVal = yAxis->min() + (j * yAxis->span() / yAxis->numTicks());
-                //siLabel.setValue(labelVal);
-                //labels.append(siLabel.text());
-                //yAxis->setMaxTickLabelWidth(fm.width(siLabel.text()) + TickMarksWidth +5);
-            }
-            yAxisMargin += yAxis->maxTickLabelWidth();
-        }
+    m_frameBudget = qMax(0, msecs);
+    m_slowFrames = 0;
+    m_fastFrames = 0;
+    m_slowAppends = 0;
+    m_fastAppends = 0;
+    if (m_frameBudget == 0 && m_quality != FullQuality) {
+        m_quality = FullQuality;
+        applyQuality();
+        emit qualityChanged(m_quality);
+        refreshPixmap();
     }
+}
 
-    QRect rect(yAxisMargin + Margin,
-               Margin,
-               width() - (yAxisMargin + ( 2 * Margin)),
-               height() - (TickMarksWidth + (xAxis()->visble() * fm.height()) + (2 * Margin)));
-    m_rect = rect;
-
-    if (!rect.isValid())
+void Graph::adjustQuality(qint64 nsecs)
+{
+    if (m_frameBudget == 0)
         return;
 
-
-    QPen quiteDark = QPen(palette().dark().color().light(), 1, Qt::DotLine);
-    QPen light = QPen(palette().light().color(), 0.4);
-
-    if (m_axes->xAxis()->visble()) {
-        int previousTextXEndPoint = numeric_limits<int>::min();
-        for (int i = 0; i <= m_axes->xAxis()->numTicks(); ++i) {
-            int x = rect.left() + (i * (rect.width() - 1) / m_axes->xAxis()->numTicks());
-            double labelVal = m_axes->xAxis()->min() + (i * m_axes->xAxis()->span() / m_axes->xAxis()->numTicks());
-            //siLabel.setValue(labelVal);
-            //int textWidth = fm.width(siLabel.text());
-            //int textXPoint = x - textWidth/2;
-
-            // X Ticks
-            painter->setPen(light);
-            painter->drawLine(x, rect.top(), x, rect.bottom());
-            painter->drawLine(x, rect.bottom(), x, rect.bottom());
-
-//            if (previousTextXEndPoint < textXPoint) { // ラベルが重なる場合は表示しない
-//                // X Ticks
-//                painter->drawLine(x, rect.bottom(), x, rect.bottom());
-//                painter->drawLine(x, rect.bottom(), x, rect.bottom() + TickMarksWidth);
-
-//                // X Label
-//                painter->drawText(textXPoint,
-//                                  rect.bottom() + TickMarksWidth,
-//                                  textWidth,
-//                                  fm.height(),
-//                                  Qt::AlignTop,
-//                                  siLabel.text());
-//                previousTextXEndPoint = x + textWidth/2 + 5;
-//            }
-        }
+    // 全体再描画と追記は手間が大きく違うため連続を別々に数える (混ぜると安い追記で
+    // 遅いフレームの連続が途切れ、下げるべき時に下がらない)
+    // どちらかが続けて遅ければ下げ、もう一方に遅れがない時だけ戻す
+    // 上げ下げの閾値も離して、境目で品質が行き来しないようにする
+    int &slow = incremental ? m_slowAppends : m_slowFrames;
+    int &fast = incremental ? m_fastAppends : m_fastFrames;
+    int otherSlow = incremental ? m_slowFrames : m_slowAppends;
+    qint64 budget = qint64(m_frameBudget) * 1000000;
+    if (nsecs > budget) {
+        fast = 0;
+        if (++slow < DegradeFrames || m_quality == NoLabels)
+            return;
+        m_slowFrames = m_fastFrames = 0;
+        m_slowAppends = m_fastAppends = 0;
+        m_quality++;
+        applyQuality();
+        emit qualityChanged(m_quality);
     }
-
-    int yAxesNum = 0;
-    int yAxisLabelsOffset = 0;
-    int yAxisTicksOffset = 0;
-    foreach (const Axis* yAxis, m_axes->yAxes()) {
-        if (yAxis->visble()) {
-            int previousTextYTopPoint = numeric_limits<int>::max();
-            yAxisLabelsOffset += yAxis->maxTickLabelWidth();
-            for (int j = 0; j <= yAxis->numTicks(); ++j) {
-                int y = rect.bottom() - (j * (rect.height() - 1) / yAxis->numTicks());
-
-                if (yAxesNum == 0) { // first
-                    // Grid Line
-                    painter->setPen(light);
-                    painter->drawLine(rect.left(), y, rect.right(), y);
-                }
-
-                // Ticks
-                QPen pen(yAxis->lineColor(), 1.0);
-                painter->setPen(pen);
-                painter->drawLine(rect.left() - yAxisTicksOffset - TickMarksWidth, y,
-                                  rect.left() - yAxisTicksOffset, y);
-                painter->drawLine(rect.left() - yAxisTicksOffset, rect.top(),
-                                  rect.left() - yAxisTicksOffset, rect.bottom());
-
-                // Label
-                painter->setPen(light);
-                QString label = labels.takeFirst();
-                if ((y + fm.height()/2) < previousTextYTopPoint) {
-                    int textYPoint = y - fm.height()/2;
-                    painter->drawText(rect.left() - yAxisLabelsOffset,
-                                      textYPoint,
-                                      yAxis->maxTickLabelWidth() - TickMarksWidth,
-                                      fm.height(),
-                                      Qt::AlignRight,
-                                      label);
-                    previousTextYTopPoint = textYPoint;
-                }
-            }
-            yAxisTicksOffset = yAxisLabelsOffset;
-            yAxesNum++;
-        }
+    else if (nsecs < budget / 2) {
+        slow = 0;
+        if (++fast < RestoreFrames || otherSlow > 0 || m_quality == FullQuality)
+            return;
+        m_slowFrames = m_fastFrames = 0;
+        m_slowAppends = m_fastAppends = 0;
+        m_quality--;
+        applyQuality();
+        emit qualityChanged(m_quality);
+        refreshPixmap(); // 余裕があるので戻した品質で描き直す
     }
-    painter->drawRect(rect.adjusted(0, 0, -1, -1));
-
-    QMapIterator<Axis*, Plot*> i(m_plotMap);
-    while (i.hasNext()) {
-        i.next();
-        Plot* plot = i.value();
-        plot->clearPlottedPoint();
+    else {
+        slow = 0;
+        fast = 0;
     }
-
 }
 
-void Graph::drawCurves(QPainter *painter)
+void Graph::applyQuality()
 {
-    if (!m_rect.isValid())
-        return;
+    // 下げる時は描き直さず、次の全体再描画から反映する
+    m_renderer->setDecimation(m_quality >= Decimated);
+    m_renderer->setLineWidthScale(m_quality >= ThinLines ? 0.0 : 1.0);
+    m_renderer->setLabelsVisible(m_quality < NoLabels);
+}
 
-    painter->setClipRect(m_rect.adjusted(+1, +1, -1, -1));
-
-    QMapIterator<Axis*, Plot*> i(m_plotMap);
-    while (i.hasNext()) {
-        i.next();
-
-        Plot* plot = i.value();
-        if (plot->visble()) {
-            Axis* yAxis = i.key();
-            int plotEndPoint = plot->count();
-            QPolygonF polyline(plotEndPoint - plot->plottedPoint());
-
-            int n = 0;
-            for (int j = plot->plottedPoint(); j < plotEndPoint; ++j) {
-                double dx = plot->xData(j) - m_axes->xAxis()->min();
-                double dy = plot->yData(j) - yAxis->min();
-                double x = m_rect.left() + (dx * (m_rect.width() - 1)
-                                          / m_axes->xAxis()->span());
-                double y = m_rect.bottom() - (dy * (m_rect.height() - 1)
-                                            / yAxis->span());
-                polyline[n++] = QPointF(x, y);
-            }
-            plot->setPlottedPoint(plotEndPoint-1);
+void Graph::onOverviewShown()
+{
+    // 保持期間がなければ要約は最初の描画にしか使わないので捨てる
+    if (m_fullResolutionSpan <= 0.0) {
+        for (int id = 0; id < m_series->count(); ++id)
+            Plot(m_series, id).setRollup(nullptr);
+    }
+    refreshPixmap();
+}
 
+void Graph::setParallelRendering(bool enabled)
+{
+    if (enabled == parallelRendering())
+        return;
 
-            QPen pen(plot->lineColor(), plot->lineWidth());
-            painter->setPen(pen);
-            painter->drawPolyline(polyline);
-        }
-    }
+    m_renderer->setTiledRendering(enabled ? TileSeries : 0);
+    refreshPixmap();
 }
 
-QMap<Axis*, Plot*> &Graph::plots()
+void Graph::syncRenderer()
 {
-    return m_plotMap;
+    m_renderer->setFont(font());
+    m_renderer->setGridColor(palette().light().color());
+    m_renderer->setFrame(isTriggerMode(), m_frameFirst, m_frameLast, m_frameOrigin);
+    m_renderer->setFullResolutionSpan(m_fullResolutionSpan);
+    m_renderer->setOverviewOnly(m_overviewFrame);
 }
 
 void Graph::setModel(QAbstractItemModel *model)
 {
-    m_plots.clear();
+    m_series->clear();
+    m_renderer->setPixelIndexEnabled(m_crosshairEnabled);
+    m_hoverPoints.clear();
+    m_series->setModel(model);
     if (model) {
-        int section = 1;
-        QVariant header;
-        do {
-            header = model->headerData(section, Qt::Horizontal);
-            if (header.toString().size()) {
-                m_plots.insert(section, new Plot(section, model, this));
-            }
-            section++;
-
-        } while(header.toString().size());
+        // 0 列目は X、以降の列を系列として登録する
+        int columns = model->columnCount();
+        m_series->reserve(columns);
+        for (int section = 1; section < columns; section++) {
+            Plot plot = m_series->at(m_series->add(section));
+            if (m_fullResolutionSpan > 0.0)
+                plot.setRollup(new Rollup(m_tierWidths));
+        }
     }
     m_model = model;
+    emit samplesReset();
+
+    if (!model)
+        return;
+
+    if (m_memoryBudget > 0)
+        setMemoryBudget(m_memoryBudget);
 
     connect(model, &QAbstractItemModel::modelReset, this, &Graph::onResetModel);
     connect(model, &QAbstractItemModel::rowsInserted, this, &Graph::onRowsInsert);
@@ -422,330 +648,553 @@ void Graph::append(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
     bool minmaxChange = false;
     for (int column = topLeft.column(); column <= bottomRight.column(); column++) {
-        if (column != 0) { // Y Axis
-            for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
-                QModelIndex yIndex = m_model->index(row, column);
-                QModelIndex xIndex = m_model->index(row, 0);
-                minmaxChange += m_plots.value(column)->calculateMinMaxData(yIndex, xIndex);
-            }
-        }
+        Plot plot = this->plot(column);
+        if (column != 0 && plot.isValid()) // Y Axis
+            minmaxChange += plot.calculateMinMaxRows(topLeft.row(), bottomRight.row());
     }
 
+    notifyAppended(topLeft.row(), bottomRight.row());
+
    if (minmaxChange)
-       emit m_plots.value(bottomRight.column())->autoScaleUpdated();
+       onAutoScaleUpdate();
    else
-       emit m_plots.value(bottomRight.column())->dataUpdated();
+       onDataUpdate();
 }
 
-
-Axes::Axes(QObject* parent)
+void Graph::setTrigger(Trigger *trigger)
 {
-    m_xAxis = new Axis(parent);
-    m_yAxes.insert(0, new Axis(parent));
-}
+    if (m_trigger == trigger)
+        return;
 
-Axes::Axes(int numAxes, QObject* parent)
-{
-    m_xAxis = new Axis(parent);
-    for (int n = 0; n < numAxes; n++)
-        m_yAxes.append(new Axis(parent));
-}
+    if (m_trigger)
+        disconnect(m_trigger, 0, this, 0);
 
-Axes::~Axes()
-{
-}
+    m_trigger = trigger;
+    m_frameFirst = m_frameLast = -1;
 
+    if (trigger) {
+        trigger->reset();
+        connect(trigger, &Trigger::triggered, this, &Graph::onTriggered);
+        connect(trigger, &Trigger::settingsChanged, this, &Graph::onTriggerSettingsChange);
+    }
 
-Axis::Axis(QObject *parent)
-    : QObject(parent),
-      m_adjustSettings({0.0, 10.0, 5}),
-      m_visble(true),
-      m_autoScale(true),
-      m_caption(QString()),
-      m_lineColor(Qt::white),
-      m_maxTickLabelWidth(0)
-{
+    onAutoScaleUpdate();
+    onRefresh();
 }
 
-bool Axis::autoScaleAdjustX(QList<Plot *> axes)
+void Graph::onTriggered(int row)
 {
-    qreal min = numeric_limits<qreal>::max();
-    qreal max = numeric_limits<qreal>::min();
-
-    foreach (Plot* plot, axes) {
-        if (min > plot->minData().x())
-            min = plot->minData().x();
-        if (max < plot->maxData().x())
-            max = plot->maxData().x();
-    }
-
-    return adjustAxis(min, max, AutoScale);
+    // 走査中はデータを読み出さず (ストアのチャンクを入れ替えないよう)、
+    // scanTrigger の後でまとめて反映する
+    m_triggeredRow = row;
 }
 
-bool Axis::autoScaleAdjustY(QList<Plot *> axes)
+void Graph::applyTrigger()
 {
-    qreal min = numeric_limits<qreal>::max();
-    qreal max = numeric_limits<qreal>::min();
+    int row = m_triggeredRow;
+    m_triggeredRow = -1;
+    Plot source = plot(m_trigger->section());
+    if (row < 0 || !source.isValid())
+        return;
 
-    foreach (Plot* plot, axes) {
-        if (min > plot->minData().y())
-            min = plot->minData().y();
-        if (max < plot->maxData().y())
-            max = plot->maxData().y();
-    }
+    m_frameFirst = row - m_trigger->preTrigger();
+    m_frameLast = row + m_trigger->postTrigger();
+    m_frameOrigin = source.xData(row);
 
-    return adjustAxis(min, max, AutoScale);
-}
+    // X 軸はトリガ点を 0 とした相対値
+    Axis* xAxis = m_axes->xAxis();
+    if (xAxis->autoScale())
+        xAxis->adjust(source.xData(m_frameFirst) - m_frameOrigin,
+                      source.xData(m_frameLast) - m_frameOrigin, Axis::Forced);
 
+    refreshPixmap();
+}
 
-bool Axis::adjustAxis(qreal min, qreal max, UpdateAdjust updateAdjust)
+void Graph::onTriggerSettingsChange()
 {
-    bool updateGrid = false;
-    if (updateAdjust == Forced || m_autoScale) {
-        const int MinTicks = 4;
-        qreal grossStep = (max - min) / MinTicks;
-        qreal step = pow(10.0, floor(log10(grossStep)));
-
-        if (qIsNaN(step) || step == 0.0)
-            return false;
+    m_frameFirst = m_frameLast = -1;
+    onAutoScaleUpdate();
+    onRefresh();
+}
 
-        if ((5 * step) < grossStep)
-            step *= 5;
-        else if ((2 * step) < grossStep)
-            step *= 2;
+bool Graph::isTriggerMode() const
+{
+    return m_trigger && m_trigger->enabled();
+}
 
-        m_adjustSettings.numTicks = int(ceil(max / step) - floor(min / step));
-        if (m_adjustSettings.numTicks < MinTicks)
-            m_adjustSettings.numTicks = MinTicks;
-        min = floor(min / step) * step;
-        max = ceil(max / step) * step;
+void Graph::scanTrigger(int first, int last)
+{
+    if (!isTriggerMode())
+        return;
 
-        if (m_adjustSettings.min != min ||
-                m_adjustSettings.max != max) {
-            updateGrid = true;
+    Plot source = plot(m_trigger->section());
+    if (!source.isValid())
+        return;
 
-            m_adjustSettings.min = min;
-            m_adjustSettings.max = max;
+    // 連続した配列で読める区間はコピーせずにそのまま渡す
+    int row = first;
+    while (row <= last) {
+        const double *x;
+        const double *y;
+        int count = source.dataBlock(row, last - row + 1, &x, &y);
+        if (count <= 0) {
+            count = last - row + 1;
+            m_triggerBuffer.resize(count);
+            double* data = m_triggerBuffer.data();
+            for (int n = 0; n < count; ++n)
+                data[n] = source.yData(row + n);
+            y = data;
         }
+        m_trigger->process(row, y, count);
+        row += count;
     }
 
-    return updateGrid;
+    applyTrigger();
 }
 
-bool Axis::autoScale() const
+void Graph::notifyAppended(int first, int last)
 {
-    return m_autoScale;
-}
+    // onRowsInsert と append の両方から呼ばれるため通知済みの行は除く
+    if (last < m_appendedRows)
+        return;
+    first = qMax(first, m_appendedRows);
+    m_appendedRows = last + 1;
 
-void Axis::setAutoScale(bool autoScale)
-{
-    if (m_autoScale != autoScale) {
-        m_autoScale = autoScale;
+    // 以降はモデルの行番号ではなく Plot のサンプル番号
+    feedStore(first, last);
+    first += m_rowOffset;
+    last += m_rowOffset;
 
-        emit autoScaleChanged(autoScale);
-    }
+    notifySamples(first, last);
 }
 
-QColor Axis::lineColor() const
+void Graph::notifySamples(int first, int last)
 {
-    return m_lineColor;
+    scanTrigger(first, last);
+    feedRollup(first, last);
+    emit rowsAppended(first, last);
 }
 
-void Axis::setLineColor(const QColor &lineColor)
+void Graph::feedRollup(int first, int last)
 {
-    if (m_lineColor != lineColor) {
-        m_lineColor = lineColor;
-        emit minMaxChanged();
-    }
-}
-
-bool Axis::visble() const
-{
-    return m_visble;
-}
+    if (m_fullResolutionSpan <= 0.0)
+        return;
 
-void Axis::setVisble(bool visble)
-{
-    if (m_visble != visble) {
-        m_visble = visble;
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        if (plot.rollup()) {
+            for (int row = first; row <= last; ++row)
+                plot.rollup()->append(plot.xData(row), plot.yData(row));
 
-        emit visbleChanged(visble);
+            // 集計済みで保持期間より古いチャンクは要約だけを残して捨てる
+            // (モデルの行はアプリケーションが持つため、古い行の削除はアプリケーション側で行う)
+            if (plot.store())
+                plot.store()->discardBefore(plot.xData(last) - m_fullResolutionSpan);
+        }
     }
 }
 
-qreal Axis::min() const
+void Graph::feedStore(int first, int last)
 {
-    return m_adjustSettings.min;
+    if (m_memoryBudget <= 0)
+        return;
+
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        ChunkStore* store = plot.store();
+        if (store) {
+            for (int row = first; row <= last; ++row)
+                store->append(m_series->modelValue(0, row),
+                              m_series->modelValue(plot.section(), row));
+        }
+    }
 }
 
-void Axis::setMin(qreal value)
+void Graph::setMemoryBudget(qint64 bytes)
 {
-    if (m_adjustSettings.min != value && !m_autoScale) {
-        if (adjustAxis(value, m_adjustSettings.max, Forced))
-            emit minMaxChanged();
+    m_memoryBudget = qMax(qint64(0), bytes);
+    qint64 budget = m_memoryBudget / qMax(1, m_series->count());
+    int rowCount = m_model ? m_model->rowCount() : 0;
+
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        if (m_memoryBudget <= 0) {
+            if (m_model) // モデルのない系列 (Ingest) はストアだけがデータを持つ
+                plot.setStore(nullptr);
+        }
+        else if (plot.store()) {
+            plot.store()->setMemoryBudget(budget);
+        }
+        else {
+            ChunkStore* store = new ChunkStore(budget);
+            store->setSpillFile(m_spillFile);
+            for (int row = 0; row < rowCount; ++row)
+                store->append(m_series->modelValue(0, row),
+                              m_series->modelValue(plot.section(), row));
+            plot.setStore(store);
+        }
     }
+
+    if (m_memoryBudget > 0 && m_rowOffset == 0)
+        m_appendedRows = rowCount;
+    else if (m_memoryBudget <= 0)
+        m_rowOffset = 0;
+
+    onRefresh();
 }
 
-qreal Axis::max() const
+void Graph::schedulePrefetch()
 {
-    return m_adjustSettings.max;
+    if (m_memoryBudget <= 0 || m_prefetchPending)
+        return;
+
+    Axis* xAxis = m_axes->xAxis();
+    double center = (xAxis->min() + xAxis->max()) / 2;
+    if (center > m_viewCenter)
+        m_viewDirection = 1;
+    else if (center < m_viewCenter)
+        m_viewDirection = -1;
+    m_viewCenter = center;
+
+    m_prefetchPending = true;
+    QTimer::singleShot(0, this, &Graph::onPrefetch);
 }
 
-void Axis::setMax(qreal value)
+void Graph::onPrefetch()
 {
-    if (m_adjustSettings.max != value && !m_autoScale) {
-        if (adjustAxis(m_adjustSettings.min, value, Forced))
-            emit minMaxChanged();
+    m_prefetchPending = false;
+    if (m_viewDirection == 0)
+        return;
+
+    // 表示範囲の移動方向にある隣のチャンクを先読みする
+    Axis* xAxis = m_axes->xAxis();
+    for (int id = 0; id < m_series->count(); ++id) {
+        ChunkStore* store = Plot(m_series, id).store();
+        int firstChunk, lastChunk;
+        if (store && store->visibleChunks(xAxis->min(), xAxis->max(), firstChunk, lastChunk))
+            store->prefetch(m_viewDirection < 0 ? firstChunk - 1 : lastChunk + 1);
     }
 }
 
-
-Plot::Plot(int section, QAbstractItemModel *model, QObject *parent)
-    : QObject(parent),
-      m_section(section),
-      m_model(model),
-      m_visble(true),
-      m_lineColor(Qt::red),
-      m_lineWidth(1.0),
-      m_minData(numeric_limits<qreal>::max(), numeric_limits<qreal>::max()),
-      m_maxData(numeric_limits<qreal>::min(), numeric_limits<qreal>::min()),
-      m_plottedCount(0),
-      m_isRecalculateMinMax(false)
+void Graph::setRetention(qreal fullResolutionSpan, const QVector<double> &tierWidths)
 {
+    m_fullResolutionSpan = qMax(qreal(0.0), fullResolutionSpan);
+    m_tierWidths = tierWidths;
+
+    // 既存のデータも集計し直す
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        if (m_fullResolutionSpan > 0.0) {
+            Rollup* rollup = new Rollup(m_tierWidths);
+            int first = plot.store() ? plot.store()->firstIndex() : 0;
+            for (int row = first; row < plot.count(); ++row)
+                rollup->append(plot.xData(row), plot.yData(row));
+            plot.setRollup(rollup);
+        }
+        else {
+            plot.setRollup(nullptr);
+        }
+    }
+
+    onRefresh();
 }
 
-bool Plot::calculateMinMaxData(const QModelIndex &yIndex, const QModelIndex &xIndex)
+bool Graph::saveSnapshot(const QString &fileName) const
 {
-    bool minmaxChange = false;
-
-    // X Axis
-    double xData = xIndex.data().toDouble();
-    if (m_maxData.x() < xData) {
-        m_maxData.setX(xData);
-        minmaxChange = true;
-    }
-    if (m_minData.x() > xData) {
-        m_minData.setX(xData);
-        minmaxChange = true;
-    }
-    // Y Axis
-    double yData = yIndex.data().toDouble();
-    if (m_maxData.y() < yData) {
-        m_maxData.setY(yData);
-        minmaxChange = true;
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QVector<Axis*> axes;
+    axes << m_axes->xAxis() << m_axes->yAxes();
+
+    Snapshot::FileHeader header = {};
+    header.magic = Snapshot::Magic;
+    header.version = Snapshot::Version;
+    header.axisCount = axes.size();
+    header.seriesCount = m_series->count();
+    header.fullResolutionSpan = m_fullResolutionSpan;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    foreach (const Axis* axis, axes) {
+        Snapshot::AxisRecord record = {};
+        record.min = axis->min();
+        record.max = axis->max();
+        record.lineColor = axis->lineColor().rgba();
+        record.visble = axis->visble();
+        record.autoScale = axis->autoScale();
+        file.write(reinterpret_cast<const char *>(&record), sizeof(record));
     }
-    if (m_minData.y() > yData) {
-        m_minData.setY(yData);
-        minmaxChange = true;
+
+    for (int id = 0; id < m_series->count(); ++id) {
+        Plot plot(m_series, id);
+        Rollup* rollup = plot.rollup();
+
+        // 保持期間の集計がない系列は全体を 1 階層に要約して保存する
+        QScopedPointer<Rollup> overview;
+        if (!rollup && plot.count() > 0 && plot.maxData().x() > plot.minData().x()) {
+            double width = (plot.maxData().x() - plot.minData().x()) / Snapshot::OverviewBuckets;
+            overview.reset(new Rollup(QVector<double>() << width, Snapshot::OverviewBuckets + 2));
+            int count = plot.count();
+            int row = plot.store() ? plot.store()->firstIndex() : 0;
+            while (row < count) {
+                const double *xs;
+                const double *ys;
+                int block = plot.dataBlock(row, count - row, &xs, &ys);
+                if (block > 0) {
+                    for (int n = 0; n < block; ++n)
+                        overview->append(xs[n], ys[n]);
+                    row += block;
+                }
+                else {
+                    overview->append(plot.xData(row), plot.yData(row));
+                    row++;
+                }
+            }
+            rollup = overview.data();
+        }
+
+        Snapshot::SeriesRecord record = {};
+        record.section = plot.section();
+        record.axis = plot.axisIndex();
+        record.lineColor = plot.lineColor().rgba();
+        record.visble = plot.visble();
+        record.xMonotonic = plot.isXMonotonic();
+        record.overview = !overview.isNull();
+        record.lineWidth = plot.lineWidth();
+        record.xMin = plot.minData().x();
+        record.xMax = plot.maxData().x();
+        record.yMin = plot.minData().y();
+        record.yMax = plot.maxData().y();
+        record.lastX = plot.lastX();
+        record.tierCount = rollup ? rollup->tierCount() : 0;
+        record.tierCapacity = rollup ? rollup->capacity() : 0;
+        file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+
+        for (int tier = 0; tier < record.tierCount; ++tier) {
+            Snapshot::TierRecord tierRecord = {};
+            tierRecord.width = rollup->tierWidth(tier);
+            tierRecord.count = rollup->bucketCount(tier);
+            tierRecord.hasCurrent = rollup->hasCurrent(tier);
+            file.write(reinterpret_cast<const char *>(&tierRecord), sizeof(tierRecord));
+
+            for (int n = 0; n < tierRecord.count; ++n) {
+                const Rollup::Bucket &bucket = rollup->bucket(tier, n);
+                Snapshot::BucketRecord bucketRecord = { bucket.x, bucket.min, bucket.max,
+                                                        bucket.sum, bucket.count };
+                file.write(reinterpret_cast<const char *>(&bucketRecord), sizeof(bucketRecord));
+            }
+        }
     }
 
-    return minmaxChange;
+    return file.commit();
 }
 
-void Plot::checkMinMaxDeleteData(const QModelIndex &yIndex, const QModelIndex &xIndex)
+bool Graph::loadSnapshot(const QString &fileName)
 {
-   bool recalculateX = true;
-   bool recalculateY = true;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    uchar *data = file.map(0, file.size());
+    if (!data)
+        return false;
+    const uchar *pos = data;
+    const uchar *end = data + file.size();
+
+    // 先に全体の範囲を確かめてから反映する
+    const Snapshot::FileHeader *header = Snapshot::read<Snapshot::FileHeader>(pos, end);
+    if (!header || header->magic != Snapshot::Magic || header->version != Snapshot::Version)
+        return false;
+
+    const Snapshot::AxisRecord *axisRecords
+            = Snapshot::read<Snapshot::AxisRecord>(pos, end, header->axisCount);
+    if (!axisRecords || header->axisCount < 1)
+        return false;
+    // 件数はファイルの残りに収まる範囲でなければ確保する前に弾く
+    if (header->seriesCount > quint64(end - pos) / sizeof(Snapshot::SeriesRecord))
+        return false;
+
+    struct SeriesEntry {
+        const Snapshot::SeriesRecord *record;
+        QVector<const Snapshot::TierRecord *> tiers;
+        QVector<const Snapshot::BucketRecord *> buckets;
+    };
+    QVector<SeriesEntry> entries(header->seriesCount);
+    for (int n = 0; n < entries.size(); ++n) {
+        SeriesEntry &entry = entries[n];
+        entry.record = Snapshot::read<Snapshot::SeriesRecord>(pos, end);
+        if (!entry.record || entry.record->tierCount < 0)
+            return false;
 
-    // X Axis
-    double xData = xIndex.data().toDouble();
-    if (m_minData.x() < xData && xData < m_maxData.x()) {
-        recalculateX = false;
+        for (int tier = 0; tier < entry.record->tierCount; ++tier) {
+            const Snapshot::TierRecord *tierRecord = Snapshot::read<Snapshot::TierRecord>(pos, end);
+            if (!tierRecord || !(tierRecord->width > 0.0))
+                return false;
+            const Snapshot::BucketRecord *buckets
+                    = Snapshot::read<Snapshot::BucketRecord>(pos, end, tierRecord->count);
+            if (!buckets)
+                return false;
+            entry.tiers.append(tierRecord);
+            entry.buckets.append(buckets);
+        }
     }
 
-    // Y Axis
-    double yData = yIndex.data().toDouble();
-    if (m_minData.y() < yData && yData < m_maxData.y()) {
-        recalculateY = false;
+    // Axis (足りない Y 軸は作る。途中の再描画は最後の 1 回にまとめる)
+    while (m_axes->yAxes().size() + 1 < int(header->axisCount))
+        addYAxis(new Axis(this));
+    QVector<Axis*> axes;
+    axes << m_axes->xAxis() << m_axes->yAxes();
+    for (int n = 0; n < int(header->axisCount); ++n) {
+        const Snapshot::AxisRecord &record = axisRecords[n];
+        Axis* axis = axes[n];
+        axis->blockSignals(true);
+        axis->setVisble(record.visble);
+        axis->setAutoScale(record.autoScale);
+        axis->setLineColor(QColor::fromRgba(record.lineColor));
+        axis->adjust(record.min, record.max, Axis::Forced);
+        axis->autoScalePolicy()->reset();
+        axis->blockSignals(false);
+    }
+    m_visbleYAxesCount = 0;
+    foreach (Axis* yAxis, m_axes->yAxes()) {
+        if (yAxis->visble())
+            m_visbleYAxesCount++;
     }
 
-    m_isRecalculateMinMax = (recalculateX || recalculateY);
-}
-
-bool Plot::recalculateMinMaxAllData(bool isForce)
-{
-    if (m_isRecalculateMinMax || isForce) {
-        clear();
-        double data;
-        for (int row = 0; row < count(); row++) {
-            // Y Axis
-            data = m_model->index(row, m_section).data().toDouble();
-            if (m_maxData.y() < data)
-                m_maxData.setY(data);
-            if (m_minData.y() > data)
-                m_minData.setY(data);
+    // Plot
+    m_fullResolutionSpan = header->fullResolutionSpan;
+    foreach (const SeriesEntry &entry, entries) {
+        const Snapshot::SeriesRecord &record = *entry.record;
+        Plot plot = this->plot(record.section);
+        if (!plot.isValid())
+            continue;
+
+        if (record.axis >= 0 && record.axis < m_axes->yAxes().size())
+            m_series->setAxisIndex(plot.id(), record.axis);
+        plot.setVisble(record.visble);
+        plot.setLineColor(QColor::fromRgba(record.lineColor));
+        plot.setLineWidth(record.lineWidth);
+        plot.restoreMinMax(QPointF(record.xMin, record.yMin), QPointF(record.xMax, record.yMax),
+                           record.xMonotonic, record.lastX);
+
+        // 要約は保持期間の集計がない場合だけ、最初の描画のために持つ
+        if (entry.tiers.isEmpty() || (record.overview && m_fullResolutionSpan > 0.0)) {
+            plot.setRollup(nullptr);
+            continue;
+        }
 
-            // X Axis
-            data = m_model->index(row, 0).data().toDouble();
-            if (m_maxData.x() < data)
-                m_maxData.setX(data);
-            if (m_minData.x() > data)
-                m_minData.setX(data);
+        QVector<double> widths;
+        foreach (const Snapshot::TierRecord *tierRecord, entry.tiers)
+            widths.append(tierRecord->width);
+        if (record.overview)
+            m_overviewFrame = true;
+        else
+            m_tierWidths = widths;
+
+        // 容量はファイルの値をそのまま信用せず、保存されたバケット数以上・上限以下にする
+        int capacity = qBound(1, int(record.tierCapacity), int(Snapshot::MaxTierCapacity));
+        foreach (const Snapshot::TierRecord *tierRecord, entry.tiers)
+            capacity = qMax(capacity, int(tierRecord->count));
+        Rollup* rollup = new Rollup(widths, capacity);
+        QVector<Rollup::Bucket> buckets;
+        for (int tier = 0; tier < entry.tiers.size(); ++tier) {
+            const Snapshot::TierRecord *tierRecord = entry.tiers.at(tier);
+            const Snapshot::BucketRecord *bucketRecords = entry.buckets.at(tier);
+            buckets.resize(tierRecord->count);
+            for (int n = 0; n < tierRecord->count; ++n) {
+                Rollup::Bucket &bucket = buckets[n];
+                bucket.x = bucketRecords[n].x;
+                bucket.min = bucketRecords[n].min;
+                bucket.max = bucketRecords[n].max;
+                bucket.sum = bucketRecords[n].sum;
+                bucket.count = int(bucketRecords[n].count);
+            }
+            rollup->restoreTier(tier, buckets.constData(), buckets.size(), tierRecord->hasCurrent);
         }
-        m_isRecalculateMinMax = false;
-        return true;
+        plot.setRollup(rollup);
     }
 
-    return false;
+    file.unmap(data);
+    refreshPixmap();
+    return true;
 }
 
-bool Plot::visble() const
+void Graph::setIngestServer(IngestServer *server)
 {
-    return m_visble;
+    if (m_ingest == server)
+        return;
+
+    // 外した後に届くバッチはサーバ側で破棄され、読み込みが止まったままにはならない
+    if (m_ingest)
+        disconnect(m_ingest, 0, this, 0);
+
+    m_ingest = server;
+    if (server)
+        connect(server, &IngestServer::batchReady, this, &Graph::onIngestBatch);
 }
 
-void Plot::setVisble(bool visble)
+void Graph::addIngestSeries(int channels)
 {
-    if (m_visble != visble) {
-        m_visble = visble;
-        emit refreshed();
+    Axis* yAxis = m_axes->yAxes().isEmpty() ? new Axis(this) : m_axes->yAxes().first();
+    qint64 budget = m_memoryBudget / qMax(1, channels);
+
+    m_series->reserve(channels);
+    for (int channel = 0; channel < channels; ++channel) {
+        Plot plot = m_series->at(m_series->add(channel + 1));
+        ChunkStore* store = budget > 0 ? new ChunkStore(budget) : new ChunkStore;
+        store->setSpillFile(m_spillFile);
+        plot.setStore(store);
+        if (m_fullResolutionSpan > 0.0)
+            plot.setRollup(new Rollup(m_tierWidths));
+        setPlot(plot, yAxis);
     }
 }
 
-QColor Plot::lineColor() const
+void Graph::onIngestBatch(const IngestBatch &batch)
 {
-    return m_lineColor;
-}
+    IngestServer* server = qobject_cast<IngestServer *>(sender());
 
-void Plot::setLineColor(const QColor &lineColor)
-{
-    if (m_lineColor != lineColor) {
-        m_lineColor = lineColor;
-        emit refreshed();
+    // モデルの系列に混ぜると行番号とサンプル番号の対応が崩れるため受け付けない
+    if (m_model) {
+        if (server)
+            server->reject(batch);
+        return;
     }
-}
 
-qreal Plot::lineWidth() const
-{
-    return m_lineWidth;
-}
+    if (m_series->count() == 0)
+        addIngestSeries(batch.channels());
 
-void Plot::setLineWidth(qreal lineWidth)
-{
-    if (m_lineWidth != lineWidth) {
-        m_lineWidth = lineWidth;
-        emit refreshed();
+    // ストアを持つ系列へそのまま追加する (モデルは経由しない)
+    int first = -1;
+    int last = -1;
+    bool minmaxChange = false;
+    const double *x = batch.x.constData();
+    for (int channel = 0; channel < batch.channels(); ++channel) {
+        Plot plot = this->plot(channel + 1);
+        ChunkStore* store = plot.isValid() ? plot.store() : 0;
+        if (!store)
+            continue;
+
+        const double *y = batch.y.at(channel).constData();
+        int count = qMin(batch.samples(), batch.y.at(channel).size());
+        if (first < 0)
+            first = store->count();
+        for (int n = 0; n < count; ++n)
+            store->append(x[n], y[n]);
+        minmaxChange |= plot.calculateMinMaxBlock(x, y, count);
+        last = qMax(last, store->count() - 1);
     }
-}
 
-void Plot::clear()
-{
-    m_plottedCount = 0;
-    m_minData.setX(numeric_limits<double>::max());
-    m_minData.setY(numeric_limits<double>::max());
-    m_maxData.setX(numeric_limits<double>::min());
-    m_maxData.setY(numeric_limits<double>::min());
-}
+    if (server)
+        server->release();
 
-int Plot::plottedPoint() const
-{
-    return m_plottedCount;
-}
+    if (first < 0 || last < first)
+        return;
 
-void Plot::setPlottedPoint(int plottedCount)
-{
-    if (plottedCount < 0)
-        m_plottedCount = 0;
+    notifySamples(first, last);
+    if (minmaxChange)
+        onAutoScaleUpdate();
     else
-        m_plottedCount = plottedCount;
+        onDataUpdate();
 }
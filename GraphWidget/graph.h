@@ -3,15 +3,22 @@
 
 
 #include <QMap>
+#include <QPainter>
 #include <QPixmap>
+#include <QTimer>
 #include <QVector>
 #include <QWidget>
 #include <QObject>
 #include <QAbstractItemModel>
 
-class Plot;
-class Axis;
-class Axes;
+#include "axis.h"
+#include "ingestserver.h"
+#include "renderer.h"
+#include "series.h"
+
+class Trigger;
+class Rollup;
+class AutoScalePolicy;
 
 class Graph : public QWidget
 {
@@ -19,21 +26,69 @@ class Graph : public QWidget
 
 public:
     Graph(QWidget *parent = 0);
+    ~Graph();
 
-    void setPlot(Plot* plot, Axis* yAxis);
+    void setPlot(Plot plot, Axis* yAxis);
     void setPlot(int column, Axis* yAxis);
 
-    QMap<Axis*, Plot*>& plots();
-    Plot* plot(int column) const { return m_plots.value(column, nullptr); }
+    SeriesRegistry* series() const { return m_series; }
+    Plot plot(int column) const { return Plot(m_series, m_series->indexOf(column)); }
     Axis* xAxis();
 
     // Model
     void setModel(QAbstractItemModel *model);
     void append(const QModelIndex &topLeft, const QModelIndex &bottomRight);
 
+    // Trigger
+    void setTrigger(Trigger *trigger);
+    Trigger* trigger() const { return m_trigger; }
+
+    // Retention
+    void setRetention(qreal fullResolutionSpan,
+                      const QVector<double> &tierWidths = QVector<double>() << 1.0 << 60.0 << 3600.0);
+    qreal fullResolutionSpan() const { return m_fullResolutionSpan; }
+
+    // Storage (予算を設定した場合、モデルは末尾への行の追加と先頭からの削除のみとする。
+    // 途中への挿入や取り込み済みの行の変更はストアに反映されない)
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return m_memoryBudget; }
+
+    // Snapshot (setModel の後に読み込む。Y 軸と系列の割り当ても戻す)
+    bool saveSnapshot(const QString &fileName) const;
+    bool loadSnapshot(const QString &fileName);
+
+    // Ingest (最初のバッチのチャンネル数で系列を作る。モデルがある間は破棄して数える)
+    void setIngestServer(IngestServer *server);
+    IngestServer* ingestServer() const { return m_ingest; }
+
+    // 全体再描画を系列のまとまりごとのタイルに分けてスレッドプールで描く
+    // (スレッド数に依らず同じ画素になるが、無効時の直接描画とはアンチエイリアスの
+    // 丸めが異なるため一致はしない)
+    void setParallelRendering(bool enabled);
+    bool parallelRendering() const { return m_renderer->tileSeries() > 0; }
+
+    // Quality (描画時間が目標を超えると段階的に品質を落とし、余裕が戻れば元に戻す)
+    enum Quality { FullQuality, NoAntialiasing, Decimated, ThinLines, NoLabels };
+    void setFrameBudget(int msecs);     // 0 で調整しない
+    int frameBudget() const { return m_frameBudget; }
+    int quality() const { return m_quality; }
+
+    // Crosshair
+    void setCrosshairEnabled(bool enabled);
+    bool crosshairEnabled() const { return m_crosshairEnabled; }
+
+signals:
+    void rowsAppended(int first, int last);
+    // サンプル番号の連続性が切れた (モデルのリセットや行の削除)
+    void samplesReset();
+    void crosshairMoved(double x);
+    void qualityChanged(int level);
+
 protected:
     void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void leaveEvent(QEvent *event);
 
 private slots:
     void onRefresh();
@@ -41,6 +96,7 @@ private slots:
     void onDataUpdate();
     void onYAxesVisbleChange(bool visble);
     void onXAxesVisbleChange(bool visible);
+    void onSeriesChange(int changes);
 
     // Model
     void onDataChange(const QModelIndex &topLeft, const QModelIndex &bottomRight,
@@ -50,152 +106,87 @@ private slots:
     void onRowsRemove(const QModelIndex &parent, int first, int last);
     void onResetModel();
 
+    // Trigger
+    void onTriggered(int row);
+    void onTriggerSettingsChange();
+
+    // Storage
+    void onPrefetch();
+
+    // Snapshot
+    void onOverviewShown();
+
+    // Ingest
+    void onIngestBatch(const IngestBatch &batch);
+
 private:
+    bool isTriggerMode() const;
+    int addYAxis(Axis *yAxis);
+    void scanTrigger(int first, int last);
+    void applyTrigger();
+    void notifyAppended(int first, int last);
+    void notifySamples(int first, int last);
+    void addIngestSeries(int channels);
+    void feedRollup(int first, int last);
+    void feedStore(int first, int last);
+    void schedulePrefetch();
     void refreshPixmap();
-    void drawGrid(QPainter *painter);
-    void drawCurves(QPainter *painter);
-
-    enum { Margin = 10,
-           TickMarksWidth = 5,
+    void syncRenderer();
+    void drawCrosshair(QPainter *painter);
+    void updateHover();
+    void adjustQuality(qint64 nsecs, bool incremental);
+    void applyQuality();
+
+    enum { TileSeries = 4,
+           ResizeDelay = 100, // リサイズが止まってから描き直すまでの時間 (ms)
+           DegradeFrames = 2,   // 全体再描画か追記が続けて予算を超えたら 1 段下げる
+           RestoreFrames = 10,  // 続けて予算の半分以下なら 1 段戻す
          };
 
-    QMultiMap<Axis*, Plot*> m_plotMap;
+    SeriesRegistry* m_series;
     Axes* m_axes;
+    Renderer* m_renderer;
     QPixmap m_pixmap;
+    QPainter m_dataPainter;     // 追記の描画用 (全体再描画で閉じる)
+    QTimer m_resizeTimer;
     int m_visbleYAxesCount;
-    QRect m_rect;
     QAbstractItemModel *m_model;
-    QMap<int, Plot*> m_plots;
-};
-
-class Plot : public QObject
-{
-    Q_OBJECT
-    Q_DISABLE_COPY(Plot)
-
-public:
-    explicit Plot(int section, QAbstractItemModel *model = 0, QObject *parent = 0);
-    virtual ~Plot(){}
-
-    QPointF minData() const { return m_minData; }
-    QPointF maxData() const { return m_maxData; }
-
-    bool visble() const;
-    void setVisble(bool visble);
-
-    QColor lineColor() const;
-    void setLineColor(const QColor &lineColor);
-
-    qreal lineWidth() const;
-    void setLineWidth(qreal lineWidth);
-
-    int count() const { return m_model->rowCount(); }
-    void clear();
-    double yData(int index) const { return m_model->index(index, m_section).data().toDouble(); }
-    double xData(int index) const { return m_model->index(index, 0).data().toDouble(); }
-
-    inline int plottedPoint() const;
-    inline void setPlottedPoint(int plottedCount);
-    void clearPlottedPoint() {m_plottedCount = 0;}
-
-    bool calculateMinMaxData(const QModelIndex &yIndex, const QModelIndex &xIndex = QModelIndex());
-    void checkMinMaxDeleteData(const QModelIndex &yIndex, const QModelIndex &xIndex = QModelIndex());
-    bool recalculateMinMaxAllData(bool isForce = false);
-
-signals:
-    void refreshed();
-    void autoScaleUpdated();
-    void dataUpdated();
-
-private:
-    int m_section;
-    QAbstractItemModel *m_model;
-    bool m_visble;
-    QColor m_lineColor;
-    qreal m_lineWidth;
-    QPointF m_minData;
-    QPointF m_maxData;
-    int m_plottedCount;
-    bool m_isRecalculateMinMax;
-};
-
-class Axis : public QObject
-{
-    Q_OBJECT
-    Q_DISABLE_COPY(Axis)
-
-public:
-    explicit Axis(QObject* parent = 0);
-    virtual ~Axis() {}
-
-    bool visble() const;
-    void setVisble(bool visble);
-
-    qreal min() const;
-    void setMin(qreal value);
-    qreal max() const;
-    void setMax(qreal value);
-    bool autoScale() const;
-    void setAutoScale(bool autoScale);
-
-    QColor lineColor() const;
-    void setLineColor(const QColor &lineColor);
-
-    enum UpdateAdjust { AutoScale, Forced };
-
-    void adjust(qreal min, qreal max,
-                UpdateAdjust updateAdjust = AutoScale) {
-        adjustAxis(min, max, updateAdjust);
-    }
-    bool autoScaleAdjustX(QList<Plot*> axes);
-    bool autoScaleAdjustY(QList<Plot*> axes);
-
-    int numTicks() const { return m_adjustSettings.numTicks; }
-    qreal span() const { return m_adjustSettings.max - m_adjustSettings.min; }
-
-    void clearMaxTickLabelWidth() { m_maxTickLabelWidth = 0; }
-    void setMaxTickLabelWidth(int width) {
-        if (m_maxTickLabelWidth < width)
-            m_maxTickLabelWidth = width;
-    }
-    int maxTickLabelWidth() const { return m_maxTickLabelWidth; }
-
-signals:
-    void visbleChanged(bool visble);
-    void autoScaleChanged(bool autoScale);
-    void minMaxChanged();
-
-private:
-    bool adjustAxis(qreal min, qreal max, UpdateAdjust updateAdjust);
-
-    struct AdjustSettings {
-        qreal min;
-        qreal max;
-        int numTicks;
-    } m_adjustSettings;
-
-    bool m_visble;
-    bool m_autoScale;
-    QString m_caption;
-    QColor m_lineColor;
-    int m_maxTickLabelWidth;
-};
-
-class Axes
-{
-
-public:
-    explicit Axes(QObject* parent = 0);
-    explicit Axes(int numAxes, QObject* parent = 0);
-    ~Axes();
-
-    Axis* xAxis() { return  m_xAxis; }
-    QVector<Axis* >& yAxes() { return m_yAxes; }
-    Axis* yAxes(int key) { return m_yAxes[key]; }
-
-private:
-    Axis* m_xAxis;
-    QVector<Axis* > m_yAxes;
+    Trigger *m_trigger;
+    int m_frameFirst;
+    int m_frameLast;
+    double m_frameOrigin;
+    int m_triggeredRow;     // 走査中に確定したフレームのトリガ行
+    bool m_overviewFrame;   // 次の全体再描画はスナップショットの要約で描く
+    QVector<double> m_triggerBuffer;
+    int m_appendedRows;
+    qreal m_fullResolutionSpan;
+    QVector<double> m_tierWidths;
+    qint64 m_memoryBudget;
+    QSharedPointer<SpillFile> m_spillFile;  // 全系列のストアで共有する
+    int m_rowOffset;
+    double m_viewCenter;
+    int m_viewDirection;
+    bool m_prefetchPending;
+
+    struct HoverPoint {
+        int id;
+        int index;
+        double x;
+        double y;
+        QPointF pos;
+    };
+    bool m_crosshairEnabled;
+    QPoint m_cursorPos;
+    QVector<HoverPoint> m_hoverPoints;
+    IngestServer *m_ingest;
+    QVector<qreal> m_axisMin;
+    QVector<qreal> m_axisMax;
+    int m_frameBudget;
+    int m_quality;
+    int m_slowFrames;
+    int m_fastFrames;
+    int m_slowAppends;          // 追記の描画は全体再描画とは別に数える
+    int m_fastAppends;
 };
 
 #endif
@@ -0,0 +1,23 @@
+#ifndef INGESTFRAME_H
+#define INGESTFRAME_H
+
+#include <QtGlobal>
+
+// IngestServer が受け取るフレームの形式 (バイト順は送信側のマシンのもの)
+//
+//   IngestFrameHeader
+//   double x[samples]
+//   double y[channels][samples]   (チャンネルごとに連続)
+struct IngestFrameHeader {
+    enum { Magic = 0x31424947, // "GIB1"
+           MaxChannels = 1024,
+           MaxFrameBytes = 16 * 1024 * 1024,
+         };
+
+    quint32 magic;
+    quint32 channels;
+    quint32 samples;
+    quint32 reserved;
+};
+
+#endif // INGESTFRAME_H
@@ -0,0 +1,232 @@
+#include "ingestserver.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMetaMethod>
+
+IngestServer::IngestServer(QObject *parent)
+    : QObject(parent),
+      m_worker(0)
+{
+    qRegisterMetaType<IngestBatch>();
+    m_shared.policy.store(Block);
+    m_shared.maxPending.store(8);
+
+    m_worker = new IngestWorker(&m_shared);
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &IngestWorker::batchReady, this, &IngestServer::onBatchReady);
+    m_thread.start();
+}
+
+IngestServer::~IngestServer()
+{
+    close();
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool IngestServer::listen(const QString &name)
+{
+    bool ok = false;
+    QMetaObject::invokeMethod(m_worker, "listen", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(bool, ok), Q_ARG(QString, name));
+    return ok;
+}
+
+void IngestServer::close()
+{
+    QMetaObject::invokeMethod(m_worker, "close", Qt::BlockingQueuedConnection);
+}
+
+void IngestServer::release()
+{
+    // 上限に達していた場合は止めていた読み込みを再開する
+    if (m_shared.pending.fetchAndAddOrdered(-1) >= m_shared.maxPending.load())
+        QMetaObject::invokeMethod(m_worker, "resume", Qt::QueuedConnection);
+}
+
+void IngestServer::reject(const IngestBatch &batch)
+{
+    m_shared.framesDropped.fetchAndAddRelaxed(batch.frames);
+    m_shared.samplesDropped.fetchAndAddRelaxed(batch.samples());
+    release();
+}
+
+void IngestServer::onBatchReady(const IngestBatch &batch)
+{
+    // 受け取り側が外れた後に届いたバッチは誰も release しないため、ここで捨てる
+    // (残したままだと Block の時に読み込みが止まったままになる)
+    if (!isSignalConnected(QMetaMethod::fromSignal(&IngestServer::batchReady))) {
+        reject(batch);
+        return;
+    }
+    emit batchReady(batch);
+}
+
+IngestWorker::IngestWorker(IngestServer::Shared *shared)
+    : QObject(0),
+      m_shared(shared),
+      m_server(0)
+{
+}
+
+bool IngestWorker::listen(const QString &name)
+{
+    close();
+
+    m_server = new QLocalServer(this);
+    connect(m_server, &QLocalServer::newConnection, this, &IngestWorker::onNewConnection);
+    if (m_server->listen(name))
+        return true;
+
+    // 異常終了したサーバのソケットが残っている場合は消してやり直す
+    QLocalServer::removeServer(name);
+    return m_server->listen(name);
+}
+
+void IngestWorker::close()
+{
+    foreach (QLocalSocket *socket, m_sockets) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_sockets.clear();
+
+    if (m_server) {
+        m_server->close();
+        m_server->deleteLater();
+        m_server = 0;
+    }
+    flush();
+}
+
+void IngestWorker::resume()
+{
+    foreach (QLocalSocket *socket, m_sockets)
+        readFrames(socket);
+}
+
+void IngestWorker::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        // 読み込みを止めた時に送信側で書き込みが詰まるよう受信バッファに上限を設ける
+        socket->setReadBufferSize(IngestFrameHeader::MaxFrameBytes);
+        connect(socket, &QLocalSocket::readyRead, this, &IngestWorker::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &IngestWorker::onDisconnected);
+        m_sockets.append(socket);
+        readFrames(socket);
+    }
+}
+
+void IngestWorker::onReadyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (socket)
+        readFrames(socket);
+}
+
+void IngestWorker::onDisconnected()
+{
+    // 受信済みのフレームは読み切ってから破棄する
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (socket)
+        readFrames(socket);
+}
+
+bool IngestWorker::isBlocked() const
+{
+    return m_shared->policy.load() == IngestServer::Block
+            && m_shared->pending.load() >= m_shared->maxPending.load();
+}
+
+void IngestWorker::readFrames(QLocalSocket *socket)
+{
+    const qint64 headerBytes = sizeof(IngestFrameHeader);
+
+    while (!isBlocked()) { // 止めた分は resume() で続きを読む
+        IngestFrameHeader header;
+        if (socket->peek(reinterpret_cast<char *>(&header), headerBytes) < headerBytes)
+            break;
+
+        qint64 payload = qint64(header.samples) * (qint64(header.channels) + 1) * qint64(sizeof(double));
+        if (header.magic != IngestFrameHeader::Magic || header.channels == 0
+                || header.channels > IngestFrameHeader::MaxChannels || header.samples == 0
+                || headerBytes + payload > IngestFrameHeader::MaxFrameBytes) {
+            // フレームの区切りが分からなくなるので接続を切る
+            m_shared->protocolErrors.fetchAndAddRelaxed(1);
+            qWarning("IngestServer: invalid frame header, closing connection");
+            socket->abort();
+            break;
+        }
+        if (socket->bytesAvailable() < headerBytes + payload)
+            break;
+
+        socket->read(reinterpret_cast<char *>(&header), headerBytes);
+        m_shared->framesReceived.fetchAndAddRelaxed(1);
+        m_shared->samplesReceived.fetchAndAddRelaxed(header.samples);
+
+        if (m_shared->policy.load() == IngestServer::Drop
+                && m_shared->pending.load() >= m_shared->maxPending.load()) {
+            m_discard.resize(qMin(payload, qint64(64 * 1024)));
+            for (qint64 left = payload; left > 0; ) {
+                qint64 bytes = socket->read(m_discard.data(), qMin(left, qint64(m_discard.size())));
+                if (bytes <= 0)
+                    break;
+                left -= bytes;
+            }
+            m_shared->framesDropped.fetchAndAddRelaxed(1);
+            m_shared->samplesDropped.fetchAndAddRelaxed(header.samples);
+            continue;
+        }
+
+        if (!readFrame(socket, header)) {
+            m_shared->protocolErrors.fetchAndAddRelaxed(1);
+            socket->abort();
+            break;
+        }
+        if (m_batch.samples() >= MaxBatchSamples)
+            flush();
+    }
+    flush();
+
+    if (socket->state() == QLocalSocket::UnconnectedState
+            && (!isBlocked() || socket->bytesAvailable() == 0)) {
+        if (m_sockets.removeOne(socket))
+            socket->deleteLater();
+    }
+}
+
+bool IngestWorker::readFrame(QLocalSocket *socket, const IngestFrameHeader &header)
+{
+    int channels = int(header.channels);
+    int samples = int(header.samples);
+    if (m_batch.samples() > 0 && m_batch.channels() != channels)
+        flush();
+    if (m_batch.y.size() != channels)
+        m_batch.y.resize(channels);
+
+    // バッチの各列の末尾へ直接読み込む
+    qint64 bytes = qint64(samples) * qint64(sizeof(double));
+    int offset = m_batch.x.size();
+    m_batch.x.resize(offset + samples);
+    bool ok = (socket->read(reinterpret_cast<char *>(m_batch.x.data() + offset), bytes) == bytes);
+    for (int channel = 0; channel < channels; ++channel) {
+        QVector<double> &column = m_batch.y[channel];
+        column.resize(offset + samples);
+        ok &= (socket->read(reinterpret_cast<char *>(column.data() + offset), bytes) == bytes);
+    }
+    m_batch.frames++;
+    return ok;
+}
+
+void IngestWorker::flush()
+{
+    if (m_batch.samples() == 0)
+        return;
+
+    m_shared->pending.fetchAndAddOrdered(1);
+    emit batchReady(m_batch);
+    m_batch = IngestBatch();
+}
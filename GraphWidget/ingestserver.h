@@ -0,0 +1,127 @@
+#ifndef INGESTSERVER_H
+#define INGESTSERVER_H
+
+#include <QAtomicInteger>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+
+#include "ingestframe.h"
+
+class QLocalServer;
+class QLocalSocket;
+class IngestWorker;
+
+// 受信したフレームをまとめたもの (y[c] が section c + 1 の系列)
+struct IngestBatch {
+    IngestBatch() : frames(0) {}
+
+    QVector<double> x;
+    QVector<QVector<double> > y;
+    int frames;     // まとめたフレーム数
+
+    int channels() const { return y.size(); }
+    int samples() const { return x.size(); }
+};
+Q_DECLARE_METATYPE(IngestBatch)
+
+// 別プロセスからのサンプルをワーカースレッドで受信・デコードし、
+// まとめたものを batchReady で受け取り側のスレッドへ渡す
+class IngestServer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(IngestServer)
+
+public:
+    // 受け取り側が追いつかない時の扱い
+    enum OverflowPolicy {
+        Block,  // 読み込みを止める (送信側の書き込みが詰まる)
+        Drop,   // 読み捨てて数える
+    };
+
+    explicit IngestServer(QObject *parent = 0);
+    virtual ~IngestServer();
+
+    bool listen(const QString &name);
+    void close();
+
+    OverflowPolicy overflowPolicy() const { return OverflowPolicy(m_shared.policy.load()); }
+    void setOverflowPolicy(OverflowPolicy policy) { m_shared.policy.store(policy); }
+    int maxPendingBatches() const { return m_shared.maxPending.load(); }
+    void setMaxPendingBatches(int count) { m_shared.maxPending.store(qMax(1, count)); }
+
+    quint64 framesReceived() const { return m_shared.framesReceived.load(); }
+    quint64 framesDropped() const { return m_shared.framesDropped.load(); }
+    quint64 samplesReceived() const { return m_shared.samplesReceived.load(); }
+    quint64 samplesDropped() const { return m_shared.samplesDropped.load(); }
+    quint64 protocolErrors() const { return m_shared.protocolErrors.load(); }
+    int pendingBatches() const { return m_shared.pending.load(); }
+
+    // batchReady を処理し終えたら呼ぶ (止めていた読み込みを再開する)
+    // 受け取り側を 1 つだけ接続すること。接続がない時に届いたバッチは破棄した分として数える
+    void release();
+    // 受け取り側で使えなかったバッチを破棄した分として数える (release も行う)
+    void reject(const IngestBatch &batch);
+
+    // ワーカーと共有する状態
+    struct Shared {
+        QAtomicInt policy;
+        QAtomicInt maxPending;
+        QAtomicInt pending;
+        QAtomicInteger<quint64> framesReceived;
+        QAtomicInteger<quint64> framesDropped;
+        QAtomicInteger<quint64> samplesReceived;
+        QAtomicInteger<quint64> samplesDropped;
+        QAtomicInteger<quint64> protocolErrors;
+    };
+
+signals:
+    void batchReady(const IngestBatch &batch);
+
+private slots:
+    void onBatchReady(const IngestBatch &batch);
+
+private:
+    Shared m_shared;
+    QThread m_thread;
+    IngestWorker *m_worker;
+};
+
+class IngestWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum { MaxBatchSamples = 65536 };
+
+    explicit IngestWorker(IngestServer::Shared *shared);
+
+public slots:
+    bool listen(const QString &name);
+    void close();
+    void resume();
+
+signals:
+    void batchReady(const IngestBatch &batch);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    bool isBlocked() const;
+    void readFrames(QLocalSocket *socket);
+    bool readFrame(QLocalSocket *socket, const IngestFrameHeader &header);
+    void flush();
+
+    IngestServer::Shared *m_shared;
+    QLocalServer *m_server;
+    QList<QLocalSocket *> m_sockets;
+    IngestBatch m_batch;
+    QVector<char> m_discard;
+};
+
+#endif // INGESTSERVER_H
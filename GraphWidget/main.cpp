@@ -11,6 +11,11 @@ int main(int argc, char *argv[])
 
     Graph graph;
 
+    // IngestProducer からの受信を待つ
+    IngestServer server;
+    if (server.listen("graph-ingest"))
+        graph.setIngestServer(&server);
+
     graph.show();
     w.show();
     return a.exec();
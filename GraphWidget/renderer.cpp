@@ -0,0 +1,574 @@
+#include "renderer.h"
+
+#include <QFontMetrics>
+#include <QPaintEngine>
+#include <QPainter>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <cmath>
+#include <limits>
+
+#include "axis.h"
+#include "rollup.h"
+
+using namespace std;
+
+Renderer::Renderer(SeriesRegistry *series, Axes *axes)
+    : m_series(series),
+      m_axes(axes),
+      m_gridPen(QColor(Qt::white), 0.4),
+      m_frameMode(false),
+      m_frameFirst(-1),
+      m_frameLast(-1),
+      m_frameOrigin(0.0),
+      m_fullResolutionSpan(0.0),
+      m_pixelIndexEnabled(false),
+      m_decimation(false),
+      m_lineWidthScale(1.0),
+      m_labelsVisible(true),
+      m_overviewOnly(false),
+      m_xScale(0.0),
+      m_tileSeries(0),
+      m_parallel(true)
+{
+}
+
+void Renderer::setFrame(bool enabled, int first, int last, double origin)
+{
+    m_frameMode = enabled;
+    m_frameFirst = first;
+    m_frameLast = last;
+    m_frameOrigin = origin;
+}
+
+void Renderer::setGridColor(const QColor &color)
+{
+    if (m_gridPen.color() != color)
+        m_gridPen = QPen(color, 0.4);
+}
+
+void Renderer::setTiledRendering(int seriesPerTile, bool parallel)
+{
+    m_tileSeries = qMax(0, seriesPerTile);
+    m_parallel = parallel;
+    if (m_tileSeries == 0)
+        m_tiles.clear();
+}
+
+void Renderer::setPixelIndexEnabled(bool enabled)
+{
+    m_pixelIndexEnabled = enabled;
+    m_pixelIndex.clear();
+}
+
+void Renderer::render(QPainter *painter, const QSize &size, const QColor &background)
+{
+    painter->fillRect(QRect(QPoint(0, 0), size), background);
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    drawGrid(painter, size);
+    drawCurves(painter);
+}
+
+QImage Renderer::renderImage(const QSize &size, QImage::Format format)
+{
+    QImage image(size, format);
+    QPainter painter(&image);
+    painter.setFont(m_font);
+    render(&painter, size);
+    return image;
+}
+
+void Renderer::drawGrid(QPainter *painter, const QSize &size)
+{
+    QFontMetrics fm(m_font);
+    Axis* xAxis = m_axes->xAxis();
+    const QVector<Axis*> &yAxes = m_axes->yAxes();
+
+    int yAxisMargin = 0;
+    for (int axis = 0; axis < yAxes.size(); ++axis) {
+        Axis* yAxis = yAxes[axis];
+        yAxis->clearMaxTickLabelWidth();
+        if (yAxis->visble()) {
+            yAxis->setMaxTickLabelWidth(tickLabels(axis + 1, yAxis, fm).maxWidth + TickMarksWidth + 5);
+            yAxisMargin += yAxis->maxTickLabelWidth();
+        }
+    }
+
+    QRect rect(yAxisMargin + Margin,
+               Margin,
+               size.width() - (yAxisMargin + ( 2 * Margin)),
+               size.height() - (TickMarksWidth + (xAxis->visble() * fm.height()) + (2 * Margin)));
+    m_rect = rect;
+
+    for (int id = 0; id < m_series->count(); ++id)
+        m_series->at(id).clearPlottedPoint();
+
+    if (!rect.isValid())
+        return;
+
+    const QPen &light = m_gridPen;
+
+    if (xAxis->visble()) {
+        const TickLabels &labels = tickLabels(0, xAxis, fm);
+        int previousTextXEndPoint = numeric_limits<int>::min();
+        for (int i = 0; i <= xAxis->numTicks(); ++i) {
+            int x = rect.left() + (i * (rect.width() - 1) / xAxis->numTicks());
+            const QString &label = labels.text.at(i);
+            int textWidth = labels.width.at(i);
+            int textXPoint = x - textWidth/2;
+
+            // X Ticks
+            painter->setPen(light);
+            painter->drawLine(x, rect.top(), x, rect.bottom());
+
+            if (m_labelsVisible && previousTextXEndPoint < textXPoint) { // ラベルが重なる場合は表示しない
+                // X Ticks
+                painter->drawLine(x, rect.bottom(), x, rect.bottom() + TickMarksWidth);
+
+                // X Label
+                painter->drawText(textXPoint,
+                                  rect.bottom() + TickMarksWidth,
+                                  textWidth,
+                                  fm.height(),
+                                  Qt::AlignTop,
+                                  label);
+                previousTextXEndPoint = x + textWidth/2 + 5;
+            }
+        }
+    }
+
+    if (m_tickPens.size() < yAxes.size())
+        m_tickPens.resize(yAxes.size());
+
+    int yAxesNum = 0;
+    int yAxisLabelsOffset = 0;
+    int yAxisTicksOffset = 0;
+    for (int axis = 0; axis < yAxes.size(); ++axis) {
+        const Axis* yAxis = yAxes[axis];
+        if (yAxis->visble()) {
+            const TickLabels &labels = m_tickLabels.at(axis + 1);
+            QPen &pen = m_tickPens[axis];
+            if (pen.color() != yAxis->lineColor())
+                pen = QPen(yAxis->lineColor(), 1.0);
+
+            int previousTextYTopPoint = numeric_limits<int>::max();
+            yAxisLabelsOffset += yAxis->maxTickLabelWidth();
+            for (int j = 0; j <= yAxis->numTicks(); ++j) {
+                int y = rect.bottom() - (j * (rect.height() - 1) / yAxis->numTicks());
+
+                if (yAxesNum == 0) { // first
+                    // Grid Line
+                    painter->setPen(light);
+                    painter->drawLine(rect.left(), y, rect.right(), y);
+                }
+
+                // Ticks
+                painter->setPen(pen);
+                painter->drawLine(rect.left() - yAxisTicksOffset - TickMarksWidth, y,
+                                  rect.left() - yAxisTicksOffset, y);
+                painter->drawLine(rect.left() - yAxisTicksOffset, rect.top(),
+                                  rect.left() - yAxisTicksOffset, rect.bottom());
+
+                // Label
+                painter->setPen(light);
+                const QString &label = labels.text.at(j);
+                if (m_labelsVisible && (y + fm.height()/2) < previousTextYTopPoint) {
+                    int textYPoint = y - fm.height()/2;
+                    painter->drawText(rect.left() - yAxisLabelsOffset,
+                                      textYPoint,
+                                      yAxis->maxTickLabelWidth() - TickMarksWidth,
+                                      fm.height(),
+                                      Qt::AlignRight,
+                                      label);
+                    previousTextYTopPoint = textYPoint;
+                }
+            }
+            yAxisTicksOffset = yAxisLabelsOffset;
+            yAxesNum++;
+        }
+    }
+    painter->drawRect(rect.adjusted(0, 0, -1, -1));
+}
+
+void Renderer::clipCurves(QPainter *painter) const
+{
+    painter->setClipRect(m_rect.adjusted(+1, +1, -1, -1));
+}
+
+void Renderer::drawCurves(QPainter *painter, bool clip)
+{
+    if (!m_rect.isValid())
+        return;
+
+    if (clip)
+        clipCurves(painter);
+
+    // 座標変換の係数は系列ごとではなく軸ごとに 1 回だけ求める
+    Axis* xAxis = m_axes->xAxis();
+    const QVector<Axis*> &yAxes = m_axes->yAxes();
+    m_xScale = (m_rect.width() - 1) / xAxis->span();
+    m_yScale.resize(yAxes.size());
+    double* yScale = m_yScale.data();
+    for (int axis = 0; axis < yAxes.size(); ++axis)
+        yScale[axis] = (m_rect.height() - 1) / yAxes[axis]->span();
+
+    // 作業用の配列とペンは系列ごとに持ち回り、定常状態では確保しない
+    if (m_scratch.size() < m_series->count()) {
+        m_scratch.resize(m_series->count());
+        m_envelopes.resize(m_series->count());
+        m_pens.resize(m_series->count());
+    }
+
+    // 座標変換 (データの読み出し) は常にこのスレッドで行う
+    bool fullFrame = true;
+    m_order.resize(0);
+    m_dirty = QRectF();
+    for (int id = 0; id < m_series->count(); ++id) {
+        bool redraw;
+        if (preparePlot(id, redraw)) {
+            m_order.append(id);
+            fullFrame &= redraw;
+        }
+    }
+
+    if (m_tileSeries > 0 && fullFrame && m_order.size() > 1
+            && painter->paintEngine()->type() == QPaintEngine::Raster) {
+        drawTiles(painter);
+    }
+    else {
+        QColor penColor;
+        qreal penWidth = -1.0;
+        foreach (int id, m_order)
+            strokePlot(painter, id, penColor, penWidth);
+    }
+
+    // 全体再描画で大きくなった分は持ち続けない
+    foreach (int id, m_order) {
+        if (m_scratch.at(id).capacity() > ScratchLimit)
+            m_scratch[id] = QPolygonF();
+        if (m_envelopes.at(id).capacity() > ScratchLimit)
+            m_envelopes[id] = QPolygonF();
+    }
+
+    m_dirtyRect = m_dirty.toAlignedRect() & m_rect;
+}
+
+bool Renderer::preparePlot(int id, bool &redraw)
+{
+    Plot plot(m_series, id);
+    int axis = plot.axisIndex();
+    if (axis < 0 || !plot.visble())
+        return false;
+
+    Axis* xAxis = m_axes->xAxis();
+    Axis* yAxis = m_axes->yAxes().at(axis);
+    int plotStartPoint = plot.plottedPoint();
+    int plotEndPoint = plot.count();
+    double xOrigin = 0.0;
+    QPolygonF &envelope = m_envelopes[id];
+    envelope.resize(0);
+    if (m_frameMode) { // 確定したフレームのみ描画
+        if (m_frameFirst < 0 || plotStartPoint > m_frameFirst)
+            return false;
+        plotStartPoint = m_frameFirst;
+        plotEndPoint = qMin(m_frameLast + 1, plotEndPoint);
+        xOrigin = m_frameOrigin;
+    }
+    else if (m_overviewOnly && plot.rollup() && plotStartPoint == 0) {
+        buildEnvelope(plot, yAxis, numeric_limits<double>::max(), envelope);
+        plotStartPoint = plotEndPoint;
+    }
+    else if (plot.rollup() && m_fullResolutionSpan > 0.0
+             && plotStartPoint == 0 && plotEndPoint > 0) {
+        // 保持期間より古い区間は集計バケットで描画
+        double rawFrom = plot.xData(plotEndPoint - 1) - m_fullResolutionSpan;
+        plotStartPoint = plot.lowerBound(rawFrom);
+        buildEnvelope(plot, yAxis, rawFrom, envelope);
+        // 表示範囲が全て集計区間に収まる場合は生のサンプルを描かない
+        if (xAxis->max() < rawFrom)
+            plotEndPoint = plotStartPoint;
+    }
+
+    bool culled = false;
+    if (plot.store() && plot.plottedPoint() == 0 && !m_frameMode && plotStartPoint < plotEndPoint) {
+        // 表示範囲に掛かるチャンクだけを読み込む
+        ChunkStore* store = plot.store();
+        int firstChunk, lastChunk;
+        plotStartPoint = qMax(plotStartPoint, store->firstIndex()); // 破棄済みの区間は集計バケットで描く
+        if (store->visibleChunks(xAxis->min(), xAxis->max(), firstChunk, lastChunk)) {
+            plotStartPoint = qMax(plotStartPoint, firstChunk * store->chunkSize() - 1);
+            plotEndPoint = qMin(plotEndPoint, (lastChunk + 1) * store->chunkSize() + 1);
+        }
+        else {
+            plotEndPoint = plotStartPoint;
+        }
+        culled = true;
+    }
+    // 集計区間の開始点とチャンクの絞り込みが食い違っても範囲が逆転しないようにする
+    plotEndPoint = qMax(plotEndPoint, plotStartPoint);
+    redraw = (plot.plottedPoint() == 0);
+    QPolygonF &polyline = m_scratch[id];
+    polyline.resize(plotEndPoint - plotStartPoint);
+
+    double xScale = m_xScale;
+    double yScale = m_yScale.at(axis);
+    double xOffset = xOrigin + xAxis->min();
+    double yOffset = yAxis->min();
+    int n = 0;
+    int j = plotStartPoint;
+    while (j < plotEndPoint) {
+        const double *xs;
+        const double *ys;
+        int count = plot.dataBlock(j, plotEndPoint - j, &xs, &ys);
+        if (count > 0) { // ブロック単位で変換
+            for (int k = 0; k < count; ++k) {
+                polyline[n++] = QPointF(m_rect.left() + ((xs[k] - xOffset) * xScale),
+                                        m_rect.bottom() - ((ys[k] - yOffset) * yScale));
+            }
+            j += count;
+        }
+        else {
+            polyline[n++] = QPointF(m_rect.left() + ((plot.xData(j) - xOffset) * xScale),
+                                    m_rect.bottom() - ((plot.yData(j) - yOffset) * yScale));
+            j++;
+        }
+    }
+    // 画素列の対応を記録する系列は点を減らさない
+    if (m_decimation && redraw && !(m_pixelIndexEnabled && !plot.isXMonotonic()))
+        polyline.resize(decimateColumns(polyline.data(), n));
+    plot.setPlottedPoint(culled ? plot.count() - 1 : plotEndPoint - 1);
+    if (m_pixelIndexEnabled && !plot.isXMonotonic())
+        updatePixelIndex(id, plotStartPoint, polyline, redraw);
+
+    const QPen &pen = cachedPen(id, plot);
+    if (redraw) {
+        m_dirty = m_rect;
+    }
+    else if (!polyline.isEmpty()) {
+        // 線幅とアンチエイリアスの分だけ広げる
+        qreal pad = qMax(qreal(1.0), pen.widthF()) / 2 + 1;
+        m_dirty |= polyline.boundingRect().adjusted(-pad, -pad, pad, pad);
+    }
+    return true;
+}
+
+void Renderer::strokePlot(QPainter *painter, int id, QColor &penColor, qreal &penWidth) const
+{
+    const QPen &pen = m_pens.at(id);
+    const QPolygonF &envelope = m_envelopes.at(id);
+    if (!envelope.isEmpty()) {
+        painter->setPen(pen);
+        painter->drawPolyline(envelope);
+        penWidth = -1.0;
+    }
+
+    // 同じ線種が続く間はペンを設定し直さない
+    if (pen.color() != penColor || pen.widthF() != penWidth) {
+        penColor = pen.color();
+        penWidth = pen.widthF();
+        painter->setPen(pen);
+    }
+    painter->drawPolyline(m_scratch.at(id));
+}
+
+void Renderer::drawTiles(QPainter *painter)
+{
+    // 系列を m_tileSeries 本ずつのグループに分け、グループごとに 1 枚のタイルへ描いて
+    // 系列の順に重ねる。グループ分けはスレッド数に依らないため、何スレッドで
+    // 描いても (1 スレッドでも) 同じ画素になる
+    int groups = (m_order.size() + m_tileSeries - 1) / m_tileSeries;
+    int wave = m_parallel ? qMax(1, QThreadPool::globalInstance()->maxThreadCount()) : 1;
+    wave = qMin(wave, groups);
+
+    if (m_tiles.size() < wave)
+        m_tiles.resize(wave);
+    for (int n = 0; n < wave; ++n) {
+        if (m_tiles.at(n).size() != m_rect.size())
+            m_tiles[n] = QImage(m_rect.size(), QImage::Format_ARGB32_Premultiplied);
+    }
+    bool antialiasing = painter->testRenderHint(QPainter::Antialiasing);
+
+    for (int first = 0; first < groups; first += wave) {
+        int count = qMin(wave, groups - first);
+        m_tileJobs.resize(count);
+        for (int n = 0; n < count; ++n) {
+            m_tileJobs[n].tile = n;
+            m_tileJobs[n].group = first + n;
+        }
+
+        if (count > 1) {
+            QtConcurrent::blockingMap(m_tileJobs, [this, antialiasing](const TileJob &job) {
+                drawTile(job, antialiasing);
+            });
+        }
+        else {
+            drawTile(m_tileJobs.at(0), antialiasing);
+        }
+
+        for (int n = 0; n < count; ++n)
+            painter->drawImage(m_rect.topLeft(), m_tiles.at(n));
+    }
+}
+
+void Renderer::drawTile(const TileJob &job, bool antialiasing) const
+{
+    // m_tiles の各要素は 1 つのジョブだけが触る
+    QImage &tile = const_cast<QImage &>(m_tiles.at(job.tile));
+    tile.fill(Qt::transparent);
+
+    QPainter painter(&tile);
+    painter.setRenderHint(QPainter::Antialiasing, antialiasing);
+    painter.translate(-m_rect.topLeft());
+    painter.setClipRect(m_rect.adjusted(+1, +1, -1, -1));
+
+    QColor penColor;
+    qreal penWidth = -1.0;
+    int last = qMin(m_order.size(), (job.group + 1) * m_tileSeries);
+    for (int n = job.group * m_tileSeries; n < last; ++n)
+        strokePlot(&painter, m_order.at(n), penColor, penWidth);
+}
+
+void Renderer::buildEnvelope(Plot plot, Axis *yAxis, double xEnd, QPolygonF &envelope)
+{
+    Rollup* rollup = plot.rollup();
+    Axis* xAxis = m_axes->xAxis();
+    double xPerPixel = xAxis->span() / qMax(1, m_rect.width());
+    int tier = rollup->selectTier(xAxis->min(), xPerPixel);
+    if (tier < 0)
+        return;
+
+    double width = rollup->tierWidth(tier);
+    int count = rollup->bucketCount(tier);
+    envelope.reserve(2 * count);
+    for (int n = 0; n < count; ++n) {
+        const Rollup::Bucket &bucket = rollup->bucket(tier, n);
+        if (bucket.x >= xEnd || bucket.x > xAxis->max())
+            break;
+        if (bucket.x + width < xAxis->min())
+            continue;
+
+        // バケットごとに min-max の縦線をつないだ包絡線
+        double dx = bucket.x + width / 2 - xAxis->min();
+        double x = m_rect.left() + (dx * (m_rect.width() - 1) / xAxis->span());
+        double yMin = m_rect.bottom() - ((bucket.min - yAxis->min()) * (m_rect.height() - 1)
+                                         / yAxis->span());
+        double yMax = m_rect.bottom() - ((bucket.max - yAxis->min()) * (m_rect.height() - 1)
+                                         / yAxis->span());
+        envelope.append(QPointF(x, yMin));
+        envelope.append(QPointF(x, yMax));
+    }
+}
+
+int Renderer::nearestByPixel(int id, int column) const
+{
+    if (id >= m_pixelIndex.size())
+        return -1;
+
+    const QVector<int> &index = m_pixelIndex.at(id);
+    int width = index.size();
+    if (column < 0 || column >= width)
+        return -1;
+
+    // カーソルの画素列から左右に広げて最初に見つかったサンプル
+    for (int offset = 0; offset < width; ++offset) {
+        if (column - offset >= 0 && index.at(column - offset) >= 0)
+            return index.at(column - offset);
+        if (column + offset < width && index.at(column + offset) >= 0)
+            return index.at(column + offset);
+        if (column - offset < 0 && column + offset >= width)
+            break;
+    }
+    return -1;
+}
+
+void Renderer::updatePixelIndex(int id, int firstIndex, const QPolygonF &polyline, bool reset)
+{
+    if (m_pixelIndex.size() < m_series->count())
+        m_pixelIndex.resize(m_series->count());
+
+    QVector<int> &index = m_pixelIndex[id];
+    int width = m_rect.width();
+    if (reset || index.size() != width)
+        index.fill(-1, width);
+
+    int* columns = index.data();
+    for (int n = 0; n < polyline.size(); ++n) {
+        int column = int(polyline.at(n).x()) - m_rect.left();
+        if (column >= 0 && column < width)
+            columns[column] = firstIndex + n;
+    }
+}
+
+const Renderer::TickLabels &Renderer::tickLabels(int key, const Axis *axis, const QFontMetrics &fm)
+{
+    if (m_tickLabels.size() <= key)
+        m_tickLabels.resize(key + 1);
+
+    // 軸の範囲か目盛り数かフォントが変わった時だけ作り直す
+    TickLabels &labels = m_tickLabels[key];
+    if (labels.min != axis->min() || labels.max != axis->max()
+            || labels.numTicks != axis->numTicks() || labels.font != m_font) {
+        labels.min = axis->min();
+        labels.max = axis->max();
+        labels.numTicks = axis->numTicks();
+        labels.font = m_font;
+        labels.text.resize(labels.numTicks + 1);
+        labels.width.resize(labels.numTicks + 1);
+        labels.maxWidth = 0;
+        for (int j = 0; j <= labels.numTicks; ++j) {
+            double labelVal = axis->min() + (j * axis->span() / axis->numTicks());
+            labels.text[j] = QString::number(labelVal);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+            labels.width[j] = fm.horizontalAdvance(labels.text.at(j));
+#else
+            labels.width[j] = fm.width(labels.text.at(j));
+#endif
+            labels.maxWidth = qMax(labels.maxWidth, labels.width.at(j));
+        }
+    }
+    return labels;
+}
+
+const QPen &Renderer::cachedPen(int id, const Plot &plot)
+{
+    if (m_pens.size() <= id)
+        m_pens.resize(m_series->count());
+
+    QPen &pen = m_pens[id];
+    qreal width = plot.lineWidth() * m_lineWidthScale;
+    if (pen.color() != plot.lineColor() || pen.widthF() != width)
+        pen = QPen(plot.lineColor(), width);
+    return pen;
+}
+
+int Renderer::decimateColumns(QPointF *points, int count)
+{
+    // 連続して同じ画素列に入る点をまとめ、縦の振れ幅と前後のつながりだけ残す
+    // 書き込み位置は常に読み出し位置以下なのでその場で詰められる
+    int out = 0;
+    int first = 0;
+    while (first < count) {
+        double column = floor(points[first].x());
+        int last = first;
+        int top = first;
+        int bottom = first;
+        while (last + 1 < count && floor(points[last + 1].x()) == column) {
+            ++last;
+            if (points[last].y() < points[top].y())
+                top = last;
+            if (points[last].y() > points[bottom].y())
+                bottom = last;
+        }
+
+        int picks[4] = { first, qMin(top, bottom), qMax(top, bottom), last };
+        int previous = -1;
+        for (int k = 0; k < 4; ++k) {
+            if (picks[k] != previous) {
+                points[out++] = points[picks[k]];
+                previous = picks[k];
+            }
+        }
+        first = last + 1;
+    }
+    return out;
+}
@@ -0,0 +1,138 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QPen>
+#include <QPolygonF>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+#include <QtNumeric>
+
+#include "series.h"
+
+class QFontMetrics;
+class QPainter;
+class Axis;
+class Axes;
+
+// 軸と系列をウィジェットなしで QPainter に描く
+// Graph の描画と一括出力 (GraphRender) の両方で使う
+class Renderer
+{
+
+public:
+    Renderer(SeriesRegistry *series, Axes *axes);
+
+    void setFont(const QFont &font) { m_font = font; }
+    void setGridColor(const QColor &color);
+
+    // トリガモードでは確定したフレームのみを描く
+    void setFrame(bool enabled, int first, int last, double origin);
+    // 保持期間より古い区間は集計バケットで描く (0 で無効)
+    void setFullResolutionSpan(qreal span) { m_fullResolutionSpan = span; }
+    // X が単調でない系列の画素列 -> サンプル番号の対応を描画時に記録する
+    void setPixelIndexEnabled(bool enabled);
+    // 全体再描画を seriesPerTile 本ずつのタイルに分けて描く (0 で直接描く)
+    // parallel ならタイルをスレッドプールで並列に描く
+    // (タイル描画どうしはスレッド数に依らず同じ画素。直接描画とは一致しない)
+    void setTiledRendering(int seriesPerTile, bool parallel = true);
+    int tileSeries() const { return m_tileSeries; }
+
+    // 描画の負荷を下げるための設定 (Graph の品質調整から使う)
+    // decimation: 全体再描画で同じ画素列の点を最初・最小・最大・最後の 4 点に減らす
+    void setDecimation(bool enabled) { m_decimation = enabled; }
+    bool decimation() const { return m_decimation; }
+    // 系列の線幅に掛ける係数 (0 で 1 ピクセルの細線)
+    void setLineWidthScale(qreal scale) { m_lineWidthScale = qMax(qreal(0.0), scale); }
+    qreal lineWidthScale() const { return m_lineWidthScale; }
+    void setLabelsVisible(bool visible) { m_labelsVisible = visible; }
+    // 集計バケットを持つ系列は全体再描画で生のサンプルを読まずに包絡線だけを描く
+    // (スナップショットを読み込んだ直後の最初の 1 枚)
+    void setOverviewOnly(bool enabled) { m_overviewOnly = enabled; }
+    bool labelsVisible() const { return m_labelsVisible; }
+
+    QRect rect() const { return m_rect; }
+    // 直前の drawCurves で描いた範囲 (追記だけなら新しい線分の外接矩形)
+    QRect dirtyRect() const { return m_dirtyRect; }
+    int nearestByPixel(int id, int column) const;
+
+    void drawGrid(QPainter *painter, const QSize &size);
+    // clip が false なら事前に clipCurves で設定したクリップをそのまま使う
+    // (クリップの設定は QPainter 内部で確保を伴うため、追記のたびに設定し直さない場合に使う)
+    void drawCurves(QPainter *painter, bool clip = true);
+    void clipCurves(QPainter *painter) const;
+
+    // 1 枚分を全て描く
+    void render(QPainter *painter, const QSize &size, const QColor &background = Qt::black);
+    QImage renderImage(const QSize &size, QImage::Format format = QImage::Format_ARGB32_Premultiplied);
+
+private:
+    struct TileJob {
+        int tile;
+        int group;
+    };
+
+    bool preparePlot(int id, bool &redraw);
+    void strokePlot(QPainter *painter, int id, QColor &penColor, qreal &penWidth) const;
+    void drawTiles(QPainter *painter);
+    void drawTile(const TileJob &job, bool antialiasing) const;
+    static int decimateColumns(QPointF *points, int count);
+    void buildEnvelope(Plot plot, Axis *yAxis, double xEnd, QPolygonF &envelope);
+    void updatePixelIndex(int id, int firstIndex, const QPolygonF &polyline, bool reset);
+
+    struct TickLabels {
+        TickLabels() : min(qQNaN()), max(qQNaN()), numTicks(-1), maxWidth(0) {}
+        qreal min;
+        qreal max;
+        int numTicks;
+        QFont font;
+        QVector<QString> text;
+        QVector<int> width;
+        int maxWidth;
+    };
+    const TickLabels& tickLabels(int key, const Axis *axis, const QFontMetrics &fm);
+    const QPen& cachedPen(int id, const Plot &plot);
+
+    enum { Margin = 10,
+           TickMarksWidth = 5,
+           ScratchLimit = 1 << 16, // これを超えた作業用配列は描画後に解放する
+         };
+
+    SeriesRegistry *m_series;
+    Axes *m_axes;
+    QFont m_font;
+    QPen m_gridPen;
+    QRect m_rect;
+    QRect m_dirtyRect;
+    QRectF m_dirty;
+    bool m_frameMode;
+    int m_frameFirst;
+    int m_frameLast;
+    double m_frameOrigin;
+    qreal m_fullResolutionSpan;
+    bool m_pixelIndexEnabled;
+    QVector<QVector<int> > m_pixelIndex;
+    bool m_decimation;
+    qreal m_lineWidthScale;
+    bool m_labelsVisible;
+    bool m_overviewOnly;
+
+    QVector<TickLabels> m_tickLabels;   // 0 は X 軸、以降は Y 軸
+    QVector<QPen> m_tickPens;
+    QVector<QPen> m_pens;
+    QVector<QPolygonF> m_scratch;
+    QVector<QPolygonF> m_envelopes;
+    double m_xScale;
+    QVector<double> m_yScale;
+    QVector<int> m_order;   // 今回描く系列 (系列順)
+    int m_tileSeries;
+    bool m_parallel;
+    QVector<QImage> m_tiles;
+    QVector<TileJob> m_tileJobs;
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,168 @@
+#include "rollup.h"
+
+#include <QtGlobal>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+Rollup::Rollup(const QVector<double> &widths, int capacity)
+    : m_capacity(qMax(1, capacity))
+{
+    foreach (double width, widths) {
+        if (width <= 0.0)
+            continue;
+
+        Tier tier;
+        tier.width = width;
+        tier.start = 0;
+        tier.count = 0;
+        tier.hasCurrent = false;
+        m_tiers.append(tier);
+    }
+}
+
+void Rollup::append(double x, double y)
+{
+    if (m_tiers.isEmpty())
+        return;
+
+    Bucket value = { x, y, y, y, 1 };
+    merge(0, value);
+}
+
+void Rollup::clear()
+{
+    for (int n = 0; n < m_tiers.size(); ++n) {
+        m_tiers[n].ring.clear();
+        m_tiers[n].start = 0;
+        m_tiers[n].count = 0;
+        m_tiers[n].hasCurrent = false;
+    }
+}
+
+void Rollup::merge(int tier, const Bucket &value)
+{
+    Tier &t = m_tiers[tier];
+    double key = floor(value.x / t.width) * t.width;
+
+    if (t.hasCurrent && t.current.x != key) {
+        // 確定したバケットをリングに入れ、上位の階層へ畳み込む
+        Bucket done = t.current;
+        if (t.count < m_capacity) {
+            // 満杯になるまではリングを使った分だけ伸ばす (系列数が多くても先に確保しない)
+            if (t.ring.size() == t.ring.capacity())
+                t.ring.reserve(qMin(m_capacity, qMax(16, 2 * t.ring.size())));
+            t.ring.append(done);
+            t.count++;
+        }
+        else {
+            t.ring[t.start] = done;
+            t.start = (t.start + 1) % m_capacity;
+        }
+        t.hasCurrent = false;
+
+        if (tier + 1 < m_tiers.size())
+            merge(tier + 1, done);
+    }
+
+    if (!t.hasCurrent) {
+        t.current = value;
+        t.current.x = key;
+        t.hasCurrent = true;
+    }
+    else {
+        t.current.min = qMin(t.current.min, value.min);
+        t.current.max = qMax(t.current.max, value.max);
+        t.current.sum += value.sum;
+        t.current.count += value.count;
+    }
+}
+
+int Rollup::bucketCount(int tier) const
+{
+    const Tier &t = m_tiers[tier];
+    return t.count + (t.hasCurrent ? 1 : 0);
+}
+
+const Rollup::Bucket &Rollup::bucket(int tier, int index) const
+{
+    const Tier &t = m_tiers[tier];
+    if (index >= t.count)
+        return t.current;
+    return t.ring[(t.start + index) % m_capacity];
+}
+
+double Rollup::oldestX(int tier) const
+{
+    const Tier &t = m_tiers[tier];
+    if (t.count)
+        return t.ring[t.start].x;
+    if (t.hasCurrent)
+        return t.current.x;
+    return numeric_limits<double>::max();
+}
+
+void Rollup::restoreTier(int tier, const Bucket *buckets, int count, bool hasCurrent)
+{
+    Tier &t = m_tiers[tier];
+    t.hasCurrent = hasCurrent && count > 0;
+    if (t.hasCurrent)
+        t.current = buckets[--count];
+
+    // 容量を超える分は古いものから捨てる
+    int skip = qMax(0, count - m_capacity);
+    t.start = 0;
+    t.count = count - skip;
+    t.ring.resize(t.count);
+    for (int n = 0; n < t.count; ++n)
+        t.ring[n] = buckets[skip + n];
+}
+
+int Rollup::selectTier(double xMin, double xPerPixel) const
+{
+    if (m_tiers.isEmpty())
+        return -1;
+
+    // 1 ピクセルに 1 バケット以下となる最も細かい階層を選び、
+    // 表示範囲の先頭まで遡れない場合はさらに粗い階層を使う
+    int tier = 0;
+    while (tier + 1 < m_tiers.size() && m_tiers[tier].width < xPerPixel)
+        tier++;
+    while (tier + 1 < m_tiers.size() && oldestX(tier) > xMin)
+        tier++;
+
+    return tier;
+}
+
+bool Rollup::minMax(double &xMin, double &xMax, double &yMin, double &yMax) const
+{
+    if (m_tiers.isEmpty())
+        return false;
+
+    bool found = false;
+    xMin = yMin = numeric_limits<double>::max();
+    xMax = yMax = -numeric_limits<double>::max();
+
+    // 最も粗い階層のリングと各階層の集計中バケットで全履歴を覆う
+    const Tier &coarsest = m_tiers.last();
+    for (int n = 0; n < coarsest.count; ++n) {
+        const Bucket &b = coarsest.ring[(coarsest.start + n) % m_capacity];
+        xMin = qMin(xMin, b.x);
+        xMax = qMax(xMax, b.x);
+        yMin = qMin(yMin, b.min);
+        yMax = qMax(yMax, b.max);
+        found = true;
+    }
+    foreach (const Tier &t, m_tiers) {
+        if (t.hasCurrent) {
+            xMin = qMin(xMin, t.current.x);
+            xMax = qMax(xMax, t.current.x);
+            yMin = qMin(yMin, t.current.min);
+            yMax = qMax(yMax, t.current.max);
+            found = true;
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,58 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <QVector>
+
+class Rollup
+{
+
+public:
+    struct Bucket {
+        double x;
+        double min;
+        double max;
+        double sum;
+        int count;
+
+        double mean() const { return count ? sum / count : 0.0; }
+    };
+
+    explicit Rollup(const QVector<double> &widths = QVector<double>() << 1.0 << 60.0 << 3600.0,
+                    int capacity = 4096);
+
+    void append(double x, double y);
+    void clear();
+
+    int tierCount() const { return m_tiers.size(); }
+    double tierWidth(int tier) const { return m_tiers[tier].width; }
+    int capacity() const { return m_capacity; }
+    bool hasCurrent(int tier) const { return m_tiers[tier].hasCurrent; }
+
+    // index 0 が最も古いバケット (末尾は集計中のバケット)
+    int bucketCount(int tier) const;
+    const Bucket& bucket(int tier, int index) const;
+    double oldestX(int tier) const;
+
+    // 保存したバケットを古い順に戻す (hasCurrent なら末尾は集計中のバケット)
+    void restoreTier(int tier, const Bucket *buckets, int count, bool hasCurrent);
+
+    int selectTier(double xMin, double xPerPixel) const;
+    bool minMax(double &xMin, double &xMax, double &yMin, double &yMax) const;
+
+private:
+    struct Tier {
+        double width;
+        QVector<Bucket> ring;
+        int start;
+        int count;
+        Bucket current;
+        bool hasCurrent;
+    };
+
+    void merge(int tier, const Bucket &value);
+
+    QVector<Tier> m_tiers;
+    int m_capacity;
+};
+
+#endif // ROLLUP_H
@@ -0,0 +1,407 @@
+#include "series.h"
+
+#include <QTimer>
+#include <limits>
+
+#include "rollup.h"
+
+using namespace std;
+
+SeriesRegistry::SeriesRegistry(QObject *parent)
+    : QObject(parent),
+      m_model(0),
+      m_provider(0),
+      m_pendingChanges(0)
+{
+}
+
+SeriesRegistry::~SeriesRegistry()
+{
+    clear();
+}
+
+int SeriesRegistry::add(int section)
+{
+    int id = m_section.size();
+
+    m_section.append(section);
+    m_axis.append(-1);
+    m_visble.append(true);
+    m_lineColor.append(QColor(Qt::red));
+    m_lineWidth.append(1.0);
+    m_xMin.append(numeric_limits<double>::max());
+    m_xMax.append(numeric_limits<double>::min());
+    m_yMin.append(numeric_limits<double>::max());
+    m_yMax.append(numeric_limits<double>::min());
+    m_plottedCount.append(0);
+    m_isRecalculateMinMax.append(false);
+    m_xMonotonic.append(true);
+    m_lastX.append(-numeric_limits<double>::max());
+    m_rollup.append(nullptr);
+    m_store.append(nullptr);
+
+    while (section >= m_bySection.size()) // 登録のない列は -1
+        m_bySection.append(-1);
+    m_bySection[section] = id;
+
+    return id;
+}
+
+void SeriesRegistry::clear()
+{
+    qDeleteAll(m_rollup);
+    qDeleteAll(m_store);
+
+    m_section.clear();
+    m_axis.clear();
+    m_visble.clear();
+    m_lineColor.clear();
+    m_lineWidth.clear();
+    m_xMin.clear();
+    m_xMax.clear();
+    m_yMin.clear();
+    m_yMax.clear();
+    m_plottedCount.clear();
+    m_isRecalculateMinMax.clear();
+    m_xMonotonic.clear();
+    m_lastX.clear();
+    m_rollup.clear();
+    m_store.clear();
+    m_bySection.clear();
+}
+
+void SeriesRegistry::reserve(int size)
+{
+    m_section.reserve(size);
+    m_axis.reserve(size);
+    m_visble.reserve(size);
+    m_lineColor.reserve(size);
+    m_lineWidth.reserve(size);
+    m_xMin.reserve(size);
+    m_xMax.reserve(size);
+    m_yMin.reserve(size);
+    m_yMax.reserve(size);
+    m_plottedCount.reserve(size);
+    m_isRecalculateMinMax.reserve(size);
+    m_xMonotonic.reserve(size);
+    m_lastX.reserve(size);
+    m_rollup.reserve(size);
+    m_store.reserve(size);
+}
+
+void SeriesRegistry::setModel(QAbstractItemModel *model)
+{
+    m_model = model;
+    m_provider = qobject_cast<ColumnProvider *>(model);
+}
+
+Plot SeriesRegistry::at(int id)
+{
+    return Plot(this, id);
+}
+
+void SeriesRegistry::setAxisIndex(int id, int axis)
+{
+    if (m_axis.at(id) != axis) {
+        m_axis[id] = axis;
+        // 軸ごとの範囲が変わるので自動スケールをやり直す
+        markChanged(AutoScale);
+    }
+}
+
+void SeriesRegistry::markChanged(int changes)
+{
+    // 通知先のないレジストリ (GraphRender など) ではタイマを使わない
+    if (!receivers(SIGNAL(changed(int))))
+        return;
+
+    if (!m_pendingChanges)
+        QTimer::singleShot(0, this, &SeriesRegistry::flush);
+    m_pendingChanges |= changes;
+}
+
+void SeriesRegistry::flush()
+{
+    int changes = m_pendingChanges;
+    m_pendingChanges = 0;
+    if (changes)
+        emit changed(changes);
+}
+
+
+void Plot::setVisble(bool visble)
+{
+    if (m_series->m_visble.at(m_id) != visble) {
+        m_series->m_visble[m_id] = visble;
+        m_series->markChanged(SeriesRegistry::Refresh);
+    }
+}
+
+void Plot::setLineColor(const QColor &lineColor)
+{
+    if (m_series->m_lineColor.at(m_id) != lineColor) {
+        m_series->m_lineColor[m_id] = lineColor;
+        m_series->markChanged(SeriesRegistry::Refresh);
+    }
+}
+
+void Plot::setLineWidth(qreal lineWidth)
+{
+    if (m_series->m_lineWidth.at(m_id) != lineWidth) {
+        m_series->m_lineWidth[m_id] = lineWidth;
+        m_series->markChanged(SeriesRegistry::Refresh);
+    }
+}
+
+void Plot::clear()
+{
+    m_series->m_plottedCount[m_id] = 0;
+    m_series->m_xMin[m_id] = numeric_limits<double>::max();
+    m_series->m_yMin[m_id] = numeric_limits<double>::max();
+    m_series->m_xMax[m_id] = numeric_limits<double>::min();
+    m_series->m_yMax[m_id] = numeric_limits<double>::min();
+    m_series->m_xMonotonic[m_id] = true;
+    m_series->m_lastX[m_id] = -numeric_limits<double>::max();
+}
+
+int Plot::lowerBound(double x) const
+{
+    // X は単調増加を前提とする (ストアで破棄済みの区間は探さない)
+    ChunkStore* s = store();
+    int first = s ? s->firstIndex() : 0;
+    int last = count();
+    while (first < last) {
+        int middle = first + (last - first) / 2;
+        if (xData(middle) < x)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return first;
+}
+
+int Plot::dataBlock(int first, int count, const double **x, const double **y) const
+{
+    ChunkStore* s = store();
+    if (s)
+        return s->span(first, count, x, y);
+
+    int xCount = m_series->modelBlock(0, first, count, x);
+    if (xCount <= 0)
+        return 0;
+    int yCount = m_series->modelBlock(section(), first, xCount, y);
+    return qMax(0, qMin(xCount, yCount));
+}
+
+int Plot::nearest(double x) const
+{
+    // X が単調増加の場合のみ有効 (二分探索)
+    int size = count();
+    if (size == 0)
+        return -1;
+
+    int index = lowerBound(x);
+    if (index >= size)
+        return size - 1;
+    int firstIndex = store() ? store()->firstIndex() : 0;
+    if (index > firstIndex && qAbs(xData(index - 1) - x) <= qAbs(xData(index) - x))
+        return index - 1;
+    return index;
+}
+
+void Plot::setRollup(Rollup *rollup)
+{
+    Rollup* &current = m_series->m_rollup[m_id];
+    if (current != rollup) {
+        delete current;
+        current = rollup;
+    }
+}
+
+void Plot::setStore(ChunkStore *store)
+{
+    ChunkStore* &current = m_series->m_store[m_id];
+    if (current != store) {
+        delete current;
+        current = store;
+        m_series->m_plottedCount[m_id] = 0;
+    }
+}
+
+void Plot::setPlottedPoint(int plottedCount)
+{
+    if (plottedCount < 0)
+        m_series->m_plottedCount[m_id] = 0;
+    else
+        m_series->m_plottedCount[m_id] = plottedCount;
+}
+
+bool Plot::calculateMinMaxData(const QModelIndex &yIndex, const QModelIndex &xIndex)
+{
+    return calculateMinMaxData(xIndex.data().toDouble(), yIndex.data().toDouble());
+}
+
+bool Plot::calculateMinMaxData(double xData, double yData)
+{
+    bool minmaxChange = false;
+    double &xMin = m_series->m_xMin[m_id];
+    double &xMax = m_series->m_xMax[m_id];
+    double &yMin = m_series->m_yMin[m_id];
+    double &yMax = m_series->m_yMax[m_id];
+
+    double &lastX = m_series->m_lastX[m_id];
+    if (xData < lastX)
+        m_series->m_xMonotonic[m_id] = false;
+    lastX = xData;
+
+    // X Axis
+    if (xMax < xData) {
+        xMax = xData;
+        minmaxChange = true;
+    }
+    if (xMin > xData) {
+        xMin = xData;
+        minmaxChange = true;
+    }
+    // Y Axis
+    if (yMax < yData) {
+        yMax = yData;
+        minmaxChange = true;
+    }
+    if (yMin > yData) {
+        yMin = yData;
+        minmaxChange = true;
+    }
+
+    return minmaxChange;
+}
+
+bool Plot::calculateMinMaxRows(int first, int last)
+{
+    // モデルの行番号で first から last までを取り込む
+    bool minmaxChange = false;
+    int column = section();
+    int row = first;
+    while (row <= last) {
+        const double *x;
+        const double *y;
+        int count = m_series->modelBlock(0, row, last - row + 1, &x);
+        if (count > 0)
+            count = m_series->modelBlock(column, row, count, &y);
+
+        if (count <= 0) {
+            minmaxChange |= calculateMinMaxData(m_series->modelValue(0, row),
+                                                m_series->modelValue(column, row));
+            row++;
+            continue;
+        }
+
+        minmaxChange |= calculateMinMaxBlock(x, y, count);
+        row += count;
+    }
+
+    return minmaxChange;
+}
+
+bool Plot::calculateMinMaxBlock(const double *x, const double *y, int count)
+{
+    if (count <= 0)
+        return false;
+
+    double &xMin = m_series->m_xMin[m_id];
+    double &xMax = m_series->m_xMax[m_id];
+    double &yMin = m_series->m_yMin[m_id];
+    double &yMax = m_series->m_yMax[m_id];
+    double &lastX = m_series->m_lastX[m_id];
+    if (x[0] < lastX)
+        m_series->m_xMonotonic[m_id] = false;
+    lastX = x[count - 1];
+
+    double blockXMin = xMin, blockXMax = xMax, blockYMin = yMin, blockYMax = yMax;
+    bool monotonic = true;
+    for (int n = 0; n < count; ++n) {
+        blockXMin = x[n] < blockXMin ? x[n] : blockXMin;
+        blockXMax = x[n] > blockXMax ? x[n] : blockXMax;
+        blockYMin = y[n] < blockYMin ? y[n] : blockYMin;
+        blockYMax = y[n] > blockYMax ? y[n] : blockYMax;
+        monotonic &= (n == 0 || x[n - 1] <= x[n]);
+    }
+    if (!monotonic)
+        m_series->m_xMonotonic[m_id] = false;
+    if (blockXMin != xMin || blockXMax != xMax || blockYMin != yMin || blockYMax != yMax) {
+        xMin = blockXMin;
+        xMax = blockXMax;
+        yMin = blockYMin;
+        yMax = blockYMax;
+        return true;
+    }
+    return false;
+}
+
+void Plot::checkMinMaxDeleteData(const QModelIndex &yIndex, const QModelIndex &xIndex)
+{
+    bool recalculateX = true;
+    bool recalculateY = true;
+
+    // X Axis
+    double xData = xIndex.data().toDouble();
+    if (m_series->m_xMin.at(m_id) < xData && xData < m_series->m_xMax.at(m_id)) {
+        recalculateX = false;
+    }
+
+    // Y Axis
+    double yData = yIndex.data().toDouble();
+    if (m_series->m_yMin.at(m_id) < yData && yData < m_series->m_yMax.at(m_id)) {
+        recalculateY = false;
+    }
+
+    m_series->m_isRecalculateMinMax[m_id] = (recalculateX || recalculateY);
+}
+
+bool Plot::recalculateMinMaxAllData(bool isForce)
+{
+    if (m_series->m_isRecalculateMinMax.at(m_id) || isForce) {
+        clear();
+        double &xMin = m_series->m_xMin[m_id];
+        double &xMax = m_series->m_xMax[m_id];
+        double &yMin = m_series->m_yMin[m_id];
+        double &yMax = m_series->m_yMax[m_id];
+
+        double dataXMin, dataXMax, dataYMin, dataYMax;
+        ChunkStore* s = store();
+        if (s && s->minMax(dataXMin, dataXMax, dataYMin, dataYMax)) {
+            // ストアはチャンクごとの要約から求める
+            xMin = dataXMin;
+            xMax = dataXMax;
+            yMin = dataYMin;
+            yMax = dataYMax;
+        }
+        else if (!s && count() > 0) {
+            calculateMinMaxRows(0, count() - 1);
+        }
+
+        // 削除済みの古いデータも集計バケットから範囲に含める
+        Rollup* r = rollup();
+        if (r && r->minMax(dataXMin, dataXMax, dataYMin, dataYMax)) {
+            xMin = qMin(xMin, dataXMin);
+            xMax = qMax(xMax, dataXMax);
+            yMin = qMin(yMin, dataYMin);
+            yMax = qMax(yMax, dataYMax);
+        }
+        m_series->m_isRecalculateMinMax[m_id] = false;
+        return true;
+    }
+
+    return false;
+}
+
+void Plot::restoreMinMax(const QPointF &minData, const QPointF &maxData, bool xMonotonic, double lastX)
+{
+    m_series->m_xMin[m_id] = minData.x();
+    m_series->m_yMin[m_id] = minData.y();
+    m_series->m_xMax[m_id] = maxData.x();
+    m_series->m_yMax[m_id] = maxData.y();
+    m_series->m_xMonotonic[m_id] = xMonotonic;
+    m_series->m_lastX[m_id] = lastX;
+    m_series->m_isRecalculateMinMax[m_id] = false;
+}
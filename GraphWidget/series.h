@@ -0,0 +1,162 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <QAbstractItemModel>
+#include <QColor>
+#include <QObject>
+#include <QPointF>
+#include <QVector>
+
+#include "chunkstore.h"
+#include "columnprovider.h"
+
+class Rollup;
+class Plot;
+
+// 全系列の属性を系列番号で引く配列として保持する (struct of arrays)
+class SeriesRegistry : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(SeriesRegistry)
+
+public:
+    enum Change { Refresh = 0x1, AutoScale = 0x2 };
+
+    explicit SeriesRegistry(QObject *parent = 0);
+    virtual ~SeriesRegistry();
+
+    QAbstractItemModel* model() const { return m_model; }
+    void setModel(QAbstractItemModel *model);
+    ColumnProvider* provider() const { return m_provider; }
+
+    // モデルの行番号で読む (ColumnProvider があれば QVariant を介さない)
+    double modelValue(int column, int row) const {
+        const double *data;
+        if (m_provider && m_provider->columnSpan(column, row, 1, &data) > 0)
+            return *data;
+        return m_model->index(row, column).data().toDouble();
+    }
+    int modelBlock(int column, int first, int count, const double **data) const {
+        return m_provider ? m_provider->columnSpan(column, first, count, data) : 0;
+    }
+
+    int count() const { return m_section.size(); }
+    int add(int section);
+    void clear();
+    void reserve(int size);
+
+    int indexOf(int section) const {
+        return (section >= 0 && section < m_bySection.size()) ? m_bySection.at(section) : -1;
+    }
+    Plot at(int id);
+
+    int axisIndex(int id) const { return m_axis.at(id); }
+    void setAxisIndex(int id, int axis);
+
+    // 変更はイベントループに戻った時点でまとめて 1 回通知する
+    void markChanged(int changes);
+
+signals:
+    void changed(int changes);
+
+private slots:
+    void flush();
+
+private:
+    friend class Plot;
+
+    QAbstractItemModel *m_model;
+    ColumnProvider *m_provider;
+    QVector<int> m_section;
+    QVector<int> m_axis;
+    QVector<bool> m_visble;
+    QVector<QColor> m_lineColor;
+    QVector<qreal> m_lineWidth;
+    QVector<double> m_xMin;
+    QVector<double> m_xMax;
+    QVector<double> m_yMin;
+    QVector<double> m_yMax;
+    QVector<int> m_plottedCount;
+    QVector<bool> m_isRecalculateMinMax;
+    QVector<bool> m_xMonotonic;
+    QVector<double> m_lastX;
+    QVector<Rollup*> m_rollup;
+    QVector<ChunkStore*> m_store;
+    QVector<int> m_bySection;
+    int m_pendingChanges;
+};
+
+// SeriesRegistry の 1 系列を指す軽量なハンドル (値渡しで使う)
+class Plot
+{
+
+public:
+    Plot() : m_series(0), m_id(-1) {}
+    Plot(SeriesRegistry *series, int id) : m_series(series), m_id(id) {}
+
+    bool isValid() const { return m_series && m_id >= 0; }
+    int id() const { return m_id; }
+    int section() const { return m_series->m_section.at(m_id); }
+    int axisIndex() const { return m_series->m_axis.at(m_id); }
+
+    QPointF minData() const { return QPointF(m_series->m_xMin.at(m_id), m_series->m_yMin.at(m_id)); }
+    QPointF maxData() const { return QPointF(m_series->m_xMax.at(m_id), m_series->m_yMax.at(m_id)); }
+
+    bool visble() const { return m_series->m_visble.at(m_id); }
+    void setVisble(bool visble);
+
+    QColor lineColor() const { return m_series->m_lineColor.at(m_id); }
+    void setLineColor(const QColor &lineColor);
+
+    qreal lineWidth() const { return m_series->m_lineWidth.at(m_id); }
+    void setLineWidth(qreal lineWidth);
+
+    int count() const {
+        ChunkStore* s = store();
+        return s ? s->count() : m_series->m_model->rowCount();
+    }
+    void clear();
+    double yData(int index) const {
+        ChunkStore* s = store();
+        return s ? s->y(index) : m_series->modelValue(section(), index);
+    }
+    double xData(int index) const {
+        ChunkStore* s = store();
+        return s ? s->x(index) : m_series->modelValue(0, index);
+    }
+    // first から連続して読める X/Y の配列を返す (返せない場合は 0)
+    int dataBlock(int first, int count, const double **x, const double **y) const;
+    int lowerBound(double x) const;
+    int nearest(double x) const;
+    bool isXMonotonic() const {
+        ChunkStore* s = store();
+        return s ? s->isMonotonic() : m_series->m_xMonotonic.at(m_id);
+    }
+
+    Rollup* rollup() const { return m_series->m_rollup.at(m_id); }
+    void setRollup(Rollup *rollup);
+
+    ChunkStore* store() const { return m_series->m_store.at(m_id); }
+    void setStore(ChunkStore *store);
+
+    int plottedPoint() const { return m_series->m_plottedCount.at(m_id); }
+    void setPlottedPoint(int plottedCount);
+    void clearPlottedPoint() { m_series->m_plottedCount[m_id] = 0; }
+
+    bool calculateMinMaxData(const QModelIndex &yIndex, const QModelIndex &xIndex = QModelIndex());
+    bool calculateMinMaxData(double x, double y);
+    bool calculateMinMaxRows(int first, int last);
+    bool calculateMinMaxBlock(const double *x, const double *y, int count);
+    void checkMinMaxDeleteData(const QModelIndex &yIndex, const QModelIndex &xIndex = QModelIndex());
+    bool recalculateMinMaxAllData(bool isForce = false);
+
+    // スナップショットから戻す (データは走査しない)
+    double lastX() const { return m_series->m_lastX.at(m_id); }
+    void restoreMinMax(const QPointF &minData, const QPointF &maxData, bool xMonotonic, double lastX);
+
+private:
+    SeriesRegistry *m_series;
+    int m_id;
+};
+
+#endif // SERIES_H
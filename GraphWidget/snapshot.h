@@ -0,0 +1,89 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QtGlobal>
+
+// Graph::saveSnapshot / loadSnapshot のファイル形式
+// 読み込みは QFile::map した領域をそのまま参照するため、各レコードは
+// 8 バイト境界に揃えた固定長とし、バイト順は書き込んだマシンのものとする
+//
+//   FileHeader
+//   AxisRecord x axisCount (0 番目が X 軸)
+//   SeriesRecord x seriesCount
+//     TierRecord x tierCount
+//       BucketRecord x count
+//
+// 保持期間を設定していない系列も、読み込み直後の最初の描画に使う要約
+// (OverviewBuckets 個程度の 1 階層) を overview として保存する
+namespace Snapshot {
+
+enum { Magic = 0x504e5347, // "GSNP"
+       Version = 1,
+       MaxTierCapacity = 1 << 20,  // 読み込み時の階層ごとのバケット数の上限
+       OverviewBuckets = 4096,
+     };
+
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 axisCount;
+    quint32 seriesCount;
+    double fullResolutionSpan;
+};
+
+struct AxisRecord {
+    double min;
+    double max;
+    quint32 lineColor;  // QRgb
+    quint8 visble;
+    quint8 autoScale;
+    quint8 reserved[2];
+};
+
+struct SeriesRecord {
+    qint32 section;
+    qint32 axis;
+    quint32 lineColor;  // QRgb
+    quint8 visble;
+    quint8 xMonotonic;
+    quint8 overview;    // 階層は保持期間の集計ではなく最初の描画用の要約
+    quint8 reserved;
+    double lineWidth;
+    double xMin;
+    double xMax;
+    double yMin;
+    double yMax;
+    double lastX;
+    qint32 tierCount;
+    qint32 tierCapacity;
+};
+
+struct TierRecord {
+    double width;
+    qint32 count;
+    qint32 hasCurrent;
+};
+
+struct BucketRecord {
+    double x;
+    double min;
+    double max;
+    double sum;
+    qint64 count;
+};
+
+// pos から count 個のレコードを指すポインタを返して pos を進める (足りなければ 0)
+template <typename T>
+inline const T* read(const uchar *&pos, const uchar *end, int count = 1)
+{
+    qint64 bytes = qint64(sizeof(T)) * count;
+    if (count < 0 || end - pos < bytes)
+        return 0;
+    const T* record = reinterpret_cast<const T *>(pos);
+    pos += bytes;
+    return record;
+}
+
+}
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,365 @@
+#include "spectrum.h"
+
+#include <QtGui>
+#if QT_VERSION >= 0x050000
+#include <QtWidgets>
+#endif
+#include <cmath>
+
+#include "graph.h"
+
+using namespace std;
+
+FftPlan::FftPlan(int size)
+    : m_size(0)
+{
+    setSize(size);
+}
+
+void FftPlan::setSize(int size)
+{
+    if (size < 2 || (size & (size - 1)))
+        size = 0;
+
+    m_size = size;
+    m_bitReverse.resize(size);
+    m_cos.resize(size / 2);
+    m_sin.resize(size / 2);
+
+    int bits = 0;
+    while ((1 << bits) < size)
+        bits++;
+
+    for (int i = 0; i < size; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b)
+            reversed = (reversed << 1) | ((i >> b) & 1);
+        m_bitReverse[i] = reversed;
+    }
+
+    for (int k = 0; k < size / 2; ++k) {
+        double phase = 2.0 * M_PI * k / size;
+        m_cos[k] = cos(phase);
+        m_sin[k] = -sin(phase);
+    }
+}
+
+void FftPlan::transform(double *re, double *im) const
+{
+    const int n = m_size;
+    const int *bitReverse = m_bitReverse.constData();
+    const double *cosTable = m_cos.constData();
+    const double *sinTable = m_sin.constData();
+
+    for (int i = 0; i < n; ++i) {
+        int j = bitReverse[i];
+        if (i < j) {
+            qSwap(re[i], re[j]);
+            qSwap(im[i], im[j]);
+        }
+    }
+
+    for (int length = 2; length <= n; length <<= 1) {
+        int half = length >> 1;
+        int step = n / length;
+        for (int start = 0; start < n; start += length) {
+            for (int k = 0; k < half; ++k) {
+                double wr = cosTable[k * step];
+                double wi = sinTable[k * step];
+                int a = start + k;
+                int b = a + half;
+                double tr = re[b] * wr - im[b] * wi;
+                double ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+
+SpectrumAnalyzer::SpectrumAnalyzer(QObject *parent)
+    : QObject(parent),
+      m_hop(1),
+      m_scale(0.0),
+      m_pendingStart(0),
+      m_output(0)
+{
+}
+
+void SpectrumAnalyzer::setup(int size, double overlap, int window)
+{
+    m_plan.setSize(size);
+    size = m_plan.size();
+
+    overlap = qBound(0.0, overlap, 0.95);
+    m_hop = qMax(1, int(size * (1.0 - overlap)));
+
+    m_window.resize(size);
+    double sum = 0.0;
+    for (int i = 0; i < size; ++i) {
+        double phase = 2.0 * M_PI * i / (size - 1);
+        double w;
+        switch (window) {
+        case Hann:
+            w = 0.5 - 0.5 * cos(phase);
+            break;
+        case Hamming:
+            w = 0.54 - 0.46 * cos(phase);
+            break;
+        case Blackman:
+            w = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+            break;
+        default:
+            w = 1.0;
+            break;
+        }
+        m_window[i] = w;
+        sum += w;
+    }
+    m_scale = (sum > 0.0) ? (2.0 / sum) : 0.0;
+
+    m_re.resize(size);
+    m_im.resize(size);
+    m_magnitude[0].resize(size ? (size / 2 + 1) : 0);
+    m_magnitude[1].resize(size ? (size / 2 + 1) : 0);
+
+    reset();
+}
+
+void SpectrumAnalyzer::process(const QVector<double> &samples)
+{
+    const int size = m_plan.size();
+    if (size == 0)
+        return;
+
+    m_pending += samples;
+    while (m_pending.size() - m_pendingStart >= size) {
+        computeFrame(m_pending.constData() + m_pendingStart);
+        m_pendingStart += m_hop;
+    }
+
+    // 処理済みの先頭部分を詰める (容量は保持される)
+    if (m_pendingStart > 0 && m_pendingStart >= m_pending.size() / 2) {
+        m_pending.remove(0, m_pendingStart);
+        m_pendingStart = 0;
+    }
+}
+
+void SpectrumAnalyzer::reset()
+{
+    m_pending.clear();
+    m_pendingStart = 0;
+}
+
+void SpectrumAnalyzer::computeFrame(const double *samples)
+{
+    const int size = m_plan.size();
+    double *re = m_re.data();
+    double *im = m_im.data();
+    const double *window = m_window.constData();
+
+    for (int i = 0; i < size; ++i) {
+        re[i] = samples[i] * window[i];
+        im[i] = 0.0;
+    }
+
+    m_plan.transform(re, im);
+
+    QVector<double> &output = m_magnitude[m_output];
+    m_output ^= 1;
+    double *magnitude = output.data();
+    for (int k = 0; k <= size / 2; ++k) {
+        double amplitude = sqrt(re[k] * re[k] + im[k] * im[k]) * m_scale;
+        magnitude[k] = 20.0 * log10(qMax(amplitude, 1e-12));
+    }
+
+    emit frameReady(output);
+}
+
+
+Spectrum::Spectrum(Graph *graph, int section, QWidget *parent)
+    : QWidget(parent),
+      m_graph(graph),
+      m_section(section),
+      m_displayMode(Line),
+      m_fftSize(1024),
+      m_overlap(0.5),
+      m_window(SpectrumAnalyzer::Hann),
+      m_minDb(-120.0),
+      m_maxDb(0.0),
+      m_analyzer(new SpectrumAnalyzer),
+      m_waterfallRow(0)
+{
+    setBackgroundRole(QPalette::Dark);
+    setAutoFillBackground(true);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+
+    qRegisterMetaType<QVector<double> >("QVector<double>");
+
+    for (int i = 0; i < 256; ++i) {
+        double t = i / 255.0;
+        QColor color = QColor::fromHsvF((1.0 - t) * (240.0 / 360.0), 1.0, qMin(1.0, 0.2 + 1.5 * t));
+        m_palette.append(color.rgb());
+    }
+
+    // FFT はワーカースレッドで計算する
+    m_analyzer->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_analyzer, &QObject::deleteLater);
+    connect(this, &Spectrum::setupRequested, m_analyzer, &SpectrumAnalyzer::setup);
+    connect(this, &Spectrum::samplesReady, m_analyzer, &SpectrumAnalyzer::process);
+    connect(this, &Spectrum::resetRequested, m_analyzer, &SpectrumAnalyzer::reset);
+    connect(m_analyzer, &SpectrumAnalyzer::frameReady, this, &Spectrum::onFrameReady);
+
+    connect(graph, &Graph::rowsAppended, this, &Spectrum::onRowsAppended);
+    connect(graph, &Graph::samplesReset, this, &Spectrum::resetRequested);
+
+    m_thread.start();
+    applySetup();
+}
+
+Spectrum::~Spectrum()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void Spectrum::setDisplayMode(DisplayMode mode)
+{
+    if (m_displayMode != mode) {
+        m_displayMode = mode;
+        update();
+    }
+}
+
+void Spectrum::setFftSize(int size)
+{
+    int powerOfTwo = 16;
+    while (powerOfTwo < size)
+        powerOfTwo <<= 1;
+
+    if (m_fftSize != powerOfTwo) {
+        m_fftSize = powerOfTwo;
+        applySetup();
+    }
+}
+
+void Spectrum::setOverlap(double overlap)
+{
+    overlap = qBound(0.0, overlap, 0.95);
+    if (m_overlap != overlap) {
+        m_overlap = overlap;
+        applySetup();
+    }
+}
+
+void Spectrum::setWindow(SpectrumAnalyzer::Window window)
+{
+    if (m_window != window) {
+        m_window = window;
+        applySetup();
+    }
+}
+
+void Spectrum::setRange(double minDb, double maxDb)
+{
+    if (minDb < maxDb) {
+        m_minDb = minDb;
+        m_maxDb = maxDb;
+        update();
+    }
+}
+
+void Spectrum::paintEvent(QPaintEvent * /* event */)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    if (m_displayMode == Waterfall) {
+        if (m_waterfall.isNull())
+            return;
+
+        // 最新の行が上になるようにリングを 2 分割して描画
+        double rowHeight = double(height()) / WaterfallRows;
+        int upper = WaterfallRows - m_waterfallRow;
+        painter.drawImage(QRectF(0, 0, width(), upper * rowHeight),
+                          m_waterfall,
+                          QRectF(0, m_waterfallRow, m_waterfall.width(), upper));
+        if (m_waterfallRow > 0)
+            painter.drawImage(QRectF(0, upper * rowHeight, width(), m_waterfallRow * rowHeight),
+                              m_waterfall,
+                              QRectF(0, 0, m_waterfall.width(), m_waterfallRow));
+    }
+    else {
+        int bins = m_spectrum.size();
+        if (bins < 2)
+            return;
+
+        QPolygonF polyline(bins);
+        double span = m_maxDb - m_minDb;
+        for (int k = 0; k < bins; ++k) {
+            double x = k * (width() - 1) / double(bins - 1);
+            double y = (m_maxDb - m_spectrum[k]) * (height() - 1) / span;
+            polyline[k] = QPointF(x, y);
+        }
+
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        painter.setPen(QPen(Qt::green, 1.0));
+        painter.drawPolyline(polyline);
+    }
+}
+
+void Spectrum::onRowsAppended(int first, int last)
+{
+    Plot plot = m_graph->plot(m_section);
+    if (!plot.isValid())
+        return;
+
+    QVector<double> samples(last - first + 1);
+    for (int n = 0; n < samples.size(); ++n)
+        samples[n] = plot.yData(first + n);
+
+    emit samplesReady(samples);
+}
+
+void Spectrum::onFrameReady(const QVector<double> &magnitude)
+{
+    m_spectrum = magnitude;
+
+    if (m_waterfall.width() != magnitude.size()) {
+        m_waterfall = QImage(magnitude.size(), WaterfallRows, QImage::Format_RGB32);
+        clearWaterfall();
+    }
+
+    // 1 フレームにつき 1 行追加
+    m_waterfallRow = (m_waterfallRow + WaterfallRows - 1) % WaterfallRows;
+    QRgb *line = reinterpret_cast<QRgb *>(m_waterfall.scanLine(m_waterfallRow));
+    for (int k = 0; k < magnitude.size(); ++k)
+        line[k] = colorOf(magnitude[k]);
+
+    update();
+}
+
+void Spectrum::applySetup()
+{
+    emit setupRequested(m_fftSize, m_overlap, int(m_window));
+    m_spectrum.clear();
+    clearWaterfall();
+    update();
+}
+
+void Spectrum::clearWaterfall()
+{
+    if (!m_waterfall.isNull())
+        m_waterfall.fill(Qt::black);
+    m_waterfallRow = 0;
+}
+
+QRgb Spectrum::colorOf(double db) const
+{
+    double t = (db - m_minDb) / (m_maxDb - m_minDb);
+    int index = qBound(0, int(t * 255.0), 255);
+    return m_palette[index];
+}
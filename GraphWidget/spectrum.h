@@ -0,0 +1,127 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <QImage>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include <QWidget>
+
+class Graph;
+
+class FftPlan
+{
+public:
+    explicit FftPlan(int size = 0);
+
+    int size() const { return m_size; }
+    void setSize(int size);
+
+    // re/im を in-place で変換 (size は 2 のべき乗)
+    void transform(double *re, double *im) const;
+
+private:
+    int m_size;
+    QVector<int> m_bitReverse;
+    QVector<double> m_cos;
+    QVector<double> m_sin;
+};
+
+class SpectrumAnalyzer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(SpectrumAnalyzer)
+
+public:
+    enum Window { Rectangular, Hann, Hamming, Blackman };
+
+    explicit SpectrumAnalyzer(QObject *parent = 0);
+    virtual ~SpectrumAnalyzer() {}
+
+public slots:
+    void setup(int size, double overlap, int window);
+    void process(const QVector<double> &samples);
+    void reset();
+
+signals:
+    void frameReady(const QVector<double> &magnitude);
+
+private:
+    void computeFrame(const double *samples);
+
+    FftPlan m_plan;
+    int m_hop;
+    double m_scale;
+    QVector<double> m_window;
+    QVector<double> m_pending;
+    int m_pendingStart;
+    QVector<double> m_re;
+    QVector<double> m_im;
+    // 受け取り側がまだ参照している間に書き換えて複製されないよう 2 つを交互に使う
+    QVector<double> m_magnitude[2];
+    int m_output;
+};
+
+class Spectrum : public QWidget
+{
+    Q_OBJECT
+
+public:
+    enum DisplayMode { Line, Waterfall };
+
+    explicit Spectrum(Graph *graph, int section, QWidget *parent = 0);
+    ~Spectrum();
+
+    int section() const { return m_section; }
+
+    DisplayMode displayMode() const { return m_displayMode; }
+    void setDisplayMode(DisplayMode mode);
+
+    int fftSize() const { return m_fftSize; }
+    void setFftSize(int size);
+    double overlap() const { return m_overlap; }
+    void setOverlap(double overlap);
+    SpectrumAnalyzer::Window window() const { return m_window; }
+    void setWindow(SpectrumAnalyzer::Window window);
+
+    void setRange(double minDb, double maxDb);
+    double minDb() const { return m_minDb; }
+    double maxDb() const { return m_maxDb; }
+
+signals:
+    void setupRequested(int size, double overlap, int window);
+    void samplesReady(const QVector<double> &samples);
+    void resetRequested();
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private slots:
+    void onRowsAppended(int first, int last);
+    void onFrameReady(const QVector<double> &magnitude);
+
+private:
+    void applySetup();
+    void clearWaterfall();
+    QRgb colorOf(double db) const;
+
+    enum { WaterfallRows = 256 };
+
+    Graph *m_graph;
+    int m_section;
+    DisplayMode m_displayMode;
+    int m_fftSize;
+    double m_overlap;
+    SpectrumAnalyzer::Window m_window;
+    double m_minDb;
+    double m_maxDb;
+
+    QThread m_thread;
+    SpectrumAnalyzer *m_analyzer;
+    QVector<double> m_spectrum;
+    QImage m_waterfall;
+    int m_waterfallRow;
+    QVector<QRgb> m_palette;
+};
+
+#endif // SPECTRUM_H
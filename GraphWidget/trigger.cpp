@@ -0,0 +1,261 @@
+#include "trigger.h"
+
+#include <QtGlobal>
+
+Trigger::Trigger(int section, QObject *parent)
+    : QObject(parent),
+      m_section(section),
+      m_enabled(true),
+      m_slope(Rising),
+      m_mode(Normal),
+      m_level(0.0),
+      m_hysteresis(0.0),
+      m_armLevel(0.0),
+      m_preTrigger(0),
+      m_postTrigger(100),
+      m_armed(false),
+      m_stopped(false),
+      m_nextRow(0),
+      m_pendingRow(-1)
+{
+}
+
+void Trigger::setSection(int section)
+{
+    if (m_section != section) {
+        m_section = section;
+        reset();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::setEnabled(bool enabled)
+{
+    if (m_enabled != enabled) {
+        m_enabled = enabled;
+        rearm();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::setSlope(Slope slope)
+{
+    if (m_slope != slope) {
+        m_slope = slope;
+        updateThresholds();
+        rearm();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::setMode(Mode mode)
+{
+    if (m_mode != mode) {
+        m_mode = mode;
+        rearm();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::setLevel(double level)
+{
+    if (m_level != level) {
+        m_level = level;
+        updateThresholds();
+        rearm();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::setHysteresis(double hysteresis)
+{
+    hysteresis = qAbs(hysteresis);
+    if (m_hysteresis != hysteresis) {
+        m_hysteresis = hysteresis;
+        updateThresholds();
+        rearm();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::setPreTrigger(int samples)
+{
+    samples = qMax(0, samples);
+    if (m_preTrigger != samples) {
+        m_preTrigger = samples;
+        rearm();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::setPostTrigger(int samples)
+{
+    samples = qMax(0, samples);
+    if (m_postTrigger != samples) {
+        m_postTrigger = samples;
+        rearm();
+        emit settingsChanged();
+    }
+}
+
+void Trigger::rearm()
+{
+    m_armed = false;
+    m_stopped = false;
+    m_pendingRow = -1;
+}
+
+void Trigger::reset()
+{
+    rearm();
+    m_nextRow = 0;
+}
+
+void Trigger::removeRows(int first, int count)
+{
+    if (count <= 0 || first >= m_nextRow)
+        return;
+
+    int last = first + count - 1;
+    m_nextRow -= qMin(m_nextRow - 1, last) - first + 1;
+
+    // 確定待ちのフレームの一部が消えた場合は取り消す
+    if (m_pendingRow >= 0) {
+        if (m_pendingRow - m_preTrigger <= last && m_pendingRow + m_postTrigger >= first)
+            m_pendingRow = -1;
+        else if (m_pendingRow > last)
+            m_pendingRow -= count;
+    }
+}
+
+void Trigger::process(int firstRow, const double *data, int count)
+{
+    if (!m_enabled || count <= 0)
+        return;
+
+    if (firstRow < m_nextRow) { // 走査済みの行は読み飛ばす
+        int skip = m_nextRow - firstRow;
+        if (skip >= count)
+            return;
+        data += skip;
+        count -= skip;
+        firstRow = m_nextRow;
+    }
+    else if (firstRow > m_nextRow) { // 欠落がある場合は状態を破棄
+        m_armed = false;
+        m_pendingRow = -1;
+    }
+
+    // 確定したフレームはこのブロックで最後のものだけを走査後に 1 回通知する
+    // (走査中に通知すると受け取り側の再描画がブロック内のイベントの数だけ走る)
+    int end = firstRow + count;
+    int row = firstRow;
+    int fired = -1;
+    while (row < end) {
+        if (m_pendingRow >= 0) {
+            // post trigger 区間が揃うまで待つ (この間はホールドオフ)
+            int frameEnd = m_pendingRow + m_postTrigger;
+            if (frameEnd >= end)
+                break;
+
+            fired = m_pendingRow;
+            m_pendingRow = -1;
+            row = frameEnd + 1;
+            if (m_mode == Single)
+                m_stopped = true;
+            continue;
+        }
+
+        if (m_stopped)
+            break;
+
+        int index = findEvent(data + (row - firstRow), end - row);
+        if (index < 0)
+            break;
+
+        int hit = row + index;
+        row = hit + 1;
+        if (hit >= m_preTrigger)
+            m_pendingRow = hit;
+    }
+
+    m_nextRow = end;
+    if (fired >= 0)
+        emit triggered(fired);
+}
+
+int Trigger::findEvent(const double *data, int count)
+{
+    int i = 0;
+    while (i < count) {
+        int end = qMin(i + int(BlockSize), count);
+
+        // ブロックの min/max で閾値を跨がない区間をまとめて読み飛ばす
+        // (分岐のないループなのでコンパイラがベクトル化できる)
+        double blockMin = data[i];
+        double blockMax = data[i];
+        for (int j = i + 1; j < end; ++j) {
+            blockMin = data[j] < blockMin ? data[j] : blockMin;
+            blockMax = data[j] > blockMax ? data[j] : blockMax;
+        }
+
+        bool candidate;
+        switch (m_slope) {
+        case Rising:
+            candidate = m_armed ? (blockMax >= m_level) : (blockMin < m_armLevel);
+            break;
+        case Falling:
+            candidate = m_armed ? (blockMin <= m_level) : (blockMax > m_armLevel);
+            break;
+        default:
+            candidate = (blockMax >= m_level);
+            break;
+        }
+
+        if (!candidate) {
+            i = end;
+            continue;
+        }
+
+        for (; i < end; ++i) {
+            double value = data[i];
+            switch (m_slope) {
+            case Rising:
+                if (!m_armed) {
+                    // 閾値ちょうどに留まる信号で再アームしないよう厳密に下回った時だけ
+                    if (value < m_armLevel)
+                        m_armed = true;
+                }
+                else if (value >= m_level) {
+                    m_armed = false;
+                    return i;
+                }
+                break;
+            case Falling:
+                if (!m_armed) {
+                    if (value > m_armLevel)
+                        m_armed = true;
+                }
+                else if (value <= m_level) {
+                    m_armed = false;
+                    return i;
+                }
+                break;
+            default:
+                if (value >= m_level)
+                    return i;
+                break;
+            }
+        }
+    }
+
+    return -1;
+}
+
+void Trigger::updateThresholds()
+{
+    if (m_slope == Falling)
+        m_armLevel = m_level + m_hysteresis;
+    else
+        m_armLevel = m_level - m_hysteresis;
+}
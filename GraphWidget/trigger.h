@@ -0,0 +1,73 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <QObject>
+
+class Trigger : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(Trigger)
+
+public:
+    enum Slope { Rising, Falling, Level };
+    enum Mode { Normal, Single };
+
+    explicit Trigger(int section, QObject *parent = 0);
+    virtual ~Trigger() {}
+
+    int section() const { return m_section; }
+    void setSection(int section);
+
+    bool enabled() const { return m_enabled; }
+    void setEnabled(bool enabled);
+
+    Slope slope() const { return m_slope; }
+    void setSlope(Slope slope);
+    Mode mode() const { return m_mode; }
+    void setMode(Mode mode);
+
+    double level() const { return m_level; }
+    void setLevel(double level);
+    double hysteresis() const { return m_hysteresis; }
+    void setHysteresis(double hysteresis);
+
+    int preTrigger() const { return m_preTrigger; }
+    void setPreTrigger(int samples);
+    int postTrigger() const { return m_postTrigger; }
+    void setPostTrigger(int samples);
+
+    void rearm();
+    void reset();
+    // 先頭側の行が削除された分だけ走査位置をずらす
+    void removeRows(int first, int count);
+
+    // 新規サンプルのみを走査する (firstRow は先頭サンプルの行番号)
+    void process(int firstRow, const double *data, int count);
+
+signals:
+    void triggered(int row);
+    void settingsChanged();
+
+private:
+    int findEvent(const double *data, int count);
+    void updateThresholds();
+
+    enum { BlockSize = 64 };
+
+    int m_section;
+    bool m_enabled;
+    Slope m_slope;
+    Mode m_mode;
+    double m_level;
+    double m_hysteresis;
+    double m_armLevel;
+    int m_preTrigger;
+    int m_postTrigger;
+
+    bool m_armed;
+    bool m_stopped;
+    int m_nextRow;
+    int m_pendingRow;
+};
+
+#endif // TRIGGER_H
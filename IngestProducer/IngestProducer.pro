@@ -0,0 +1,25 @@
+QT       += core network
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# The following define makes your compiler emit warnings if you use
+# any Qt feature that has been marked deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# フレーム形式 (IngestFrameHeader) は GraphWidget のヘッダをそのまま使う
+INCLUDEPATH += ../GraphWidget
+
+SOURCES += \
+    main.cpp
+
+HEADERS += \
+    ../GraphWidget/ingestframe.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,117 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <QtMath>
+
+#include "ingestframe.h"
+
+// IngestServer へ合成した多チャンネルのサンプルを送り続ける試験用の送信側
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("IngestProducer");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sends synthetic sample frames to a Graph IngestServer.");
+    parser.addHelpOption();
+
+    QCommandLineOption nameOption(QStringList() << "n" << "name", "Server name.", "name", "graph-ingest");
+    QCommandLineOption channelsOption(QStringList() << "c" << "channels", "Channels per frame.", "n", "4");
+    QCommandLineOption rateOption(QStringList() << "r" << "rate", "Samples per second (0 = as fast as possible).", "n", "10000");
+    QCommandLineOption frameOption(QStringList() << "f" << "frame", "Samples per frame.", "n", "500");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Seconds to run (0 = forever).", "s", "0");
+    parser.addOption(nameOption);
+    parser.addOption(channelsOption);
+    parser.addOption(rateOption);
+    parser.addOption(frameOption);
+    parser.addOption(durationOption);
+    parser.process(a);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    int channels = qBound(1, parser.value(channelsOption).toInt(), int(IngestFrameHeader::MaxChannels));
+    int samples = qMax(1, parser.value(frameOption).toInt());
+    double rate = qMax(0.0, parser.value(rateOption).toDouble());
+    double duration = qMax(0.0, parser.value(durationOption).toDouble());
+
+    // サーバは上限を超えるフレームを受け付けずに接続を切るため、送る前に収める
+    int maxSamples = int((IngestFrameHeader::MaxFrameBytes - sizeof(IngestFrameHeader))
+                         / ((channels + 1) * sizeof(double)));
+    if (samples > maxSamples) {
+        err << "samples per frame limited to " << maxSamples << " for " << channels << " channels\n";
+        err.flush();
+        samples = maxSamples;
+    }
+
+    QLocalSocket socket;
+    socket.connectToServer(parser.value(nameOption), QIODevice::WriteOnly);
+    if (!socket.waitForConnected(5000)) {
+        err << "cannot connect: " << socket.errorString() << "\n";
+        return 1;
+    }
+
+    IngestFrameHeader header = { IngestFrameHeader::Magic, quint32(channels), quint32(samples), 0 };
+    QVector<double> payload(samples * (channels + 1));
+
+    QElapsedTimer clock;
+    clock.start();
+    quint64 sent = 0;
+    quint64 frames = 0;
+    qint64 blockedNs = 0;
+    qint64 nextReport = 1000;
+
+    while (duration <= 0.0 || clock.elapsed() < qint64(duration * 1000)) {
+        // x の後にチャンネルごとの列を続ける
+        double *x = payload.data();
+        for (int n = 0; n < samples; ++n) {
+            double t = double(sent + n) / (rate > 0.0 ? rate : 10000.0);
+            x[n] = t;
+            for (int c = 0; c < channels; ++c)
+                x[(c + 1) * samples + n] = (c + 1) * sin(2 * M_PI * (c + 1) * t) + 0.1 * sin(97.0 * t);
+        }
+
+        socket.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        socket.write(reinterpret_cast<const char *>(payload.constData()),
+                     qint64(payload.size()) * qint64(sizeof(double)));
+
+        // 受信側が読み込みを止めている間はここで待たされる
+        QElapsedTimer blocked;
+        blocked.start();
+        while (socket.bytesToWrite() > 0) {
+            if (!socket.waitForBytesWritten(-1)) {
+                err << "connection lost: " << socket.errorString() << "\n";
+                return 1;
+            }
+        }
+        blockedNs += blocked.nsecsElapsed();
+
+        sent += samples;
+        frames++;
+
+        if (rate > 0.0) {
+            qint64 due = qint64(sent * 1000 / rate);
+            qint64 wait = due - clock.elapsed();
+            if (wait > 0)
+                QThread::msleep(wait);
+        }
+
+        if (clock.elapsed() >= nextReport) {
+            double seconds = clock.elapsed() / 1000.0;
+            out << frames << " frames, " << sent << " samples ("
+                << QString::number(sent / seconds, 'f', 0) << " samples/s), blocked "
+                << QString::number(blockedNs / 1e6, 'f', 1) << " ms" << "\n";
+            out.flush();
+            nextReport += 1000;
+        }
+    }
+
+    socket.disconnectFromServer();
+    if (socket.state() != QLocalSocket::UnconnectedState)
+        socket.waitForDisconnected(5000);
+    return 0;
+}